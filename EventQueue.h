@@ -1,10 +1,14 @@
 #ifndef EVENT_H
 #define EVENT_H
 
+#include<algorithm>
 #include<iostream>
 #include<stdlib.h>
 #include<vector>
+#include"Predicates.h"
 #include"StatusQueue.h"
+#include"NodePool.h"
+#include"SweepStats.h"
 using namespace std;
 
 /// Structure to represent a node of the event queue.
@@ -14,19 +18,115 @@ struct EventQueueNode
   double yc;              //!< Y-coordinate of event point
   EventQueueNode *left;   //!< Pointer to left child in the search tree
   EventQueueNode *right;  //!< Pointer to right child in the search tree
-  vector<LineSegment> U;  //!< Set of segments whose upper endpoint is the event point
-  vector<LineSegment> L;  //!< Set of segments whose lower endpoint is the event point
-  vector<LineSegment> C;  //!< Set of segments with the event point as an interior point
+  EventQueueNode *parent; //!< Pointer to parent in the search tree, NULL for the root
+  vector<unsigned int> U; //!< IDs of segments whose upper endpoint is the event point
+  vector<unsigned int> L; //!< IDs of segments whose lower endpoint is the event point
+  vector<unsigned int> C; //!< IDs of segments with the event point as an interior point
   int height;             //!< Height of a node in the search tree
+  unsigned int serial;    //!< Unique number of the event point, used to deduplicate C
+  unsigned int a;         //!< First segment whose intersection created the point, NO_SEGMENT for endpoints
+  unsigned int b;         //!< Second segment whose intersection created the point
 };
 
+/// Structure to represent a segment endpoint waiting to be loaded into the event queue.
+struct Endpoint
+{
+  double xc;        //!< X-coordinate of the endpoint
+  double yc;        //!< Y-coordinate of the endpoint
+  unsigned int seg; //!< ID of the line segment
+  int type;         //!< 1 for the upper endpoint, 2 for the lower endpoint
+};
+
+/// Order endpoints the way their event points are popped from the event queue
+///
+/// Points go from top to bottom and from left to right; endpoints sharing a
+/// point are ordered by segment ID so that the U and L sets come out sorted.
+inline bool endpointBefore(const Endpoint &a, const Endpoint &b)
+{
+  if (a.yc != b.yc)
+    return a.yc > b.yc;
+  if (a.xc != b.xc)
+    return a.xc < b.xc;
+  if (a.type != b.type)
+    return a.type < b.type;
+  return a.seg < b.seg;
+}
+
 /// Implementation of the event queue data strucuture.
 ///
-/// Uses a balanced binary search tree called **AVL Tree**.
+/// Uses a balanced binary search tree called **AVL Tree**. In-order is the
+/// reverse of pop order, so the next point to pop is the rightmost node; it
+/// is kept in top and unlinked through the parent pointers without a search.
 class EventQueue
 {
 
 public:
+  /// Root of the tree, NULL if it is empty
+  EventQueueNode *root;
+
+  /// Rightmost node of the tree, the next event point to pop
+  EventQueueNode *top;
+
+  /// Pool the nodes of the tree are allocated from
+  NodePool<EventQueueNode> *pool;
+
+  /// Order of the event points, exact for crossings that round alike
+  SweepOrder *order;
+
+  /// Serial number of the last event each segment was added to as an interior point
+  vector<unsigned int> lastC;
+
+  /// Serial number handed to the next event point created
+  unsigned int nextSerial;
+
+  /// Rotation counters, updated when compiled with SWEEP_STATS
+  SweepStats stats;
+
+  /// Basic constructor
+  /// @param nodePool Pool owning the nodes of this tree
+  /// @param sweepOrder Order of the event points
+  EventQueue(NodePool<EventQueueNode> *nodePool, SweepOrder *sweepOrder)
+  {
+    root = NULL;
+    top = NULL;
+    pool = nodePool;
+    order = sweepOrder;
+    nextSerial = 1;
+  }
+
+  /// Prepare the queue for segment IDs in the range [0, n)
+  void reserveSegments(size_t n)
+  {
+    lastC.assign(n, 0);
+  }
+
+  /// Check if there are no event points left
+  bool empty()
+  {
+    return root == NULL;
+  }
+
+  /// Add a segment to the U, L or C set of an event point
+  ///
+  /// Every segment has exactly one upper and one lower endpoint, so only C
+  /// can receive the same segment twice; lastC filters those repeats.
+  /// @returns 0 if the segment was already in the set, 1 otherwise
+  int addSegment(EventQueueNode *node, unsigned int seg, int type)
+  {
+    if (type == 1)
+      node->U.push_back(seg);
+    else if (type == 2)
+      node->L.push_back(seg);
+    else
+    {
+      if (lastC[seg] == node->serial)
+        return 0;
+      lastC[seg] = node->serial;
+      node->C.push_back(seg);
+    }
+    return 1;
+  }
+
   /// Find height of a node
   /// @param N Pointer to the node
   int height(EventQueueNode *N)
@@ -36,6 +136,12 @@ public:
     return N->height;
   }
 
+  /// Height of the whole tree
+  int height()
+  {
+    return height(root);
+  }
+
   /// Return the maximum of two integers a, b
   int max(int a, int b)
   {
@@ -53,49 +159,114 @@ public:
   /// 3 - intersection point
   /// @param xc X-coordinate of event point
   /// @param yc Y-coordinate of event point
-  /// @param xs X-coordinate of start point of line segment
-  /// @param ys Y-coordinate of start point of line segment
-  /// @param xe X-coordinate of end point of line segment
-  /// @param ye Y-coordinate of end point of line segment
+  /// @param seg ID of the line segment
   /// @param type Type of the event point
-  EventQueueNode *newq(double xc, double yc, double xs, double ys, double xe, double ye, int type)
+  /// @param other For intersection points, ID of the other line segment crossing there
+  EventQueueNode *newq(double xc, double yc, unsigned int seg, int type, unsigned int other = NO_SEGMENT)
   {
+    EventQueueNode *node = newNode(xc, yc, (type == 3) ? seg : NO_SEGMENT, (type == 3) ? other : NO_SEGMENT);
+    addSegment(node, seg, type);
+    return (node);
+  }
 
-    EventQueueNode *node = new EventQueueNode;
+  /// Create a new event point with empty U, L and C sets
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  EventQueueNode *newNode(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    EventQueueNode *node = pool->allocate();
 
     node->xc = xc;
     node->yc = yc;
-    LineSegment *l = new LineSegment;
-    l->startX = xs;
-    l->startY = ys;
-    l->endX = xe;
-    l->endY = ye;
-    if (type == 1)
-    {
-      node->U.push_back(*l);
-    }
-    else if (type == 2)
-    {
-      node->L.push_back(*l);
-    }
-    else
-      node->C.push_back(*l);
+    node->serial = nextSerial++;
+    node->a = a;
+    node->b = b;
 
     node->left = NULL;
     node->right = NULL;
+    node->parent = NULL;
     node->height = 1;
 
+    // a recycled node keeps the capacity of its sets
+    node->U.clear();
+    node->L.clear();
+    node->C.clear();
+
     return (node);
   }
 
+  /// Build a perfectly balanced tree from event points sorted in increasing order
+  /// @param nodes Event points, nodes[lo] being the last one to be popped
+  /// @returns Pointer to the root of the tree holding nodes[lo..hi)
+  EventQueueNode *buildBalanced(vector<EventQueueNode *> &nodes, size_t lo, size_t hi)
+  {
+    if (lo >= hi)
+      return NULL;
+
+    size_t mid = lo + (hi - lo) / 2;
+    EventQueueNode *node = nodes[mid];
+    node->left = buildBalanced(nodes, lo, mid);
+    node->right = buildBalanced(nodes, mid + 1, hi);
+    if (node->left != NULL)
+      node->left->parent = node;
+    if (node->right != NULL)
+      node->right->parent = node;
+    node->height = 1 + max(height(node->left), height(node->right));
+    return node;
+  }
+
+  /// Load all segment endpoints at once
+  ///
+  /// Coincident endpoints are merged into one event point and the tree is
+  /// built bottom up in O(n), with no rebalancing.
+  /// @param endpoints Endpoints sorted with endpointBefore
+  void bulkLoad(const vector<Endpoint> &endpoints)
+  {
+    vector<EventQueueNode *> nodes;
+    for (size_t i = 0; i < endpoints.size(); i++)
+    {
+      const Endpoint &e = endpoints[i];
+      if (nodes.empty() || nodes.back()->xc != e.xc || nodes.back()->yc != e.yc)
+        nodes.push_back(newq(e.xc, e.yc, e.seg, e.type));
+      else
+        addSegment(nodes.back(), e.seg, e.type);
+    }
+
+    // in-order is the reverse of pop order
+    reverse(nodes.begin(), nodes.end());
+    root = buildBalanced(nodes, 0, nodes.size());
+    if (root != NULL)
+      root->parent = NULL;
+    top = nodes.empty() ? NULL : nodes.back();
+  }
+
+  /// Put a node in the place of another one under its parent
+  /// @param node Replacement, may be NULL
+  void replaceChild(EventQueueNode *old, EventQueueNode *node)
+  {
+    EventQueueNode *p = old->parent;
+    if (node != NULL)
+      node->parent = p;
+    if (p == NULL)
+      root = node;
+    else if (p->left == old)
+      p->left = node;
+    else
+      p->right = node;
+  }
+
   /// Right rotate about a point in the tree to rebalance
   EventQueueNode *rightRotate(EventQueueNode *y)
   {
+    SWEEP_COUNT(stats, eventRotations);
     EventQueueNode *x = y->left;
     EventQueueNode *T2 = x->right;
 
+    replaceChild(y, x);
     x->right = y;
+    y->parent = x;
     y->left = T2;
+    if (T2 != NULL)
+      T2->parent = y;
 
     y->height = max(height(y->left), height(y->right)) + 1;
     x->height = max(height(x->left), height(x->right)) + 1;
@@ -106,58 +277,82 @@ public:
   /// Left rotate about a point in the tree to rebalance
   EventQueueNode *leftRotate(EventQueueNode *x)
   {
+    SWEEP_COUNT(stats, eventRotations);
     EventQueueNode *y = x->right;
     EventQueueNode *T2 = y->left;
 
+    replaceChild(x, y);
     y->left = x;
+    x->parent = y;
     x->right = T2;
+    if (T2 != NULL)
+      T2->parent = x;
 
     x->height = max(height(x->left), height(x->right)) + 1;
     y->height = max(height(y->left), height(y->right)) + 1;
     return y;
   }
 
-  /// Used as a comparator for insertion and deletion
-  int mygreater(double x1, double y1, double x2, double y2)
+  /// Compare a point with an event point in the tree
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  /// @returns -1 if the point is popped before the node, 1 if after it, 0 if it is the node
+  int compare(double xc, double yc, unsigned int a, unsigned int b, EventQueueNode *node)
+  {
+    return order->compareEvents(xc, yc, a, b, node->xc, node->yc, node->a, node->b);
+  }
+
+  /// Get balance factor of a node
+  int getBalance(EventQueueNode *N)
   {
-    if (y1 < y2)
+    if (N == NULL)
       return 0;
-    else if (y1 > y2)
-      return 1;
-    else
+    return height(N->left) - height(N->right);
+  }
+
+  /// Update the height of a node and restore its balance
+  /// @returns Pointer to the root of the rebalanced subtree
+  EventQueueNode *rebalance(EventQueueNode *node)
+  {
+    node->height = 1 + max(height(node->left),
+                           height(node->right));
+
+    int balance = getBalance(node);
+
+    if (balance > 1 && getBalance(node->left) >= 0)
+      return rightRotate(node);
+
+    if (balance > 1 && getBalance(node->left) < 0)
     {
-      if (x1 > x2)
-        return 0;
-      else if (x1 < x2)
-        return 1;
+      leftRotate(node->left);
+      return rightRotate(node);
     }
-    return 0;
-  }
 
+    if (balance < -1 && getBalance(node->right) <= 0)
+      return leftRotate(node);
 
-  /// Used as a comparator for insertion and deletion
-  int mylesser(double x1, double y1, double x2, double y2)
-  {
-    if (y1 < y2)
-      return 1;
-    else if (y1 > y2)
-      return 0;
-    else
+    if (balance < -1 && getBalance(node->right) > 0)
     {
-      if (x1 > x2)
-        return 1;
-      else if (x1 < x2)
-        return 0;
+      rightRotate(node->right);
+      return leftRotate(node);
     }
-    return 0;
+
+    return node;
   }
 
-  /// Get balance factor of a node
-  int getBalance(EventQueueNode *N)
+  /// Rebalance the ancestors of a changed subtree, bottom up
+  ///
+  /// Stops at the first subtree whose height did not change.
+  /// @param node Lowest node whose subtree changed
+  void retrace(EventQueueNode *node)
   {
-    if (N == NULL)
-      return 0;
-    return height(N->left) - height(N->right);
+    while (node != NULL)
+    {
+      int old = node->height;
+      node = rebalance(node);
+      if (node->height == old)
+        return;
+      node = node->parent;
+    }
   }
 
   /// Insert a new point in the event queue.
@@ -171,123 +366,72 @@ public:
   /// 3 - intersection point
   /// @param xc X-coordinate of event point
   /// @param yc Y-coordinate of event point
-  /// @param xs X-coordinate of start point of line segment
-  /// @param ys Y-coordinate of start point of line segment
-  /// @param xe X-coordinate of end point of line segment
-  /// @param ye Y-coordinate of end point of line segment
+  /// @param seg ID of the line segment
   /// @param type Type of the event point
-  EventQueueNode *insert(EventQueueNode *node, double xc, double yc, double xs, double ys, double xe, double ye, int type)
+  /// @param other For intersection points, ID of the other line segment crossing there
+  void insert(double xc, double yc, unsigned int seg, int type, unsigned int other = NO_SEGMENT)
   {
-    // printf("start insert\n");
-    if (node == NULL)
-      return (newq(xc, yc, xs, ys, xe, ye, type));
+    // the point is identified by its coordinates, and for crossings by the segments
+    EventQueueNode *node = findOrCreate(xc, yc, (type == 3) ? seg : NO_SEGMENT, (type == 3) ? other : NO_SEGMENT);
+    addSegment(node, seg, type);
+  }
 
-    if (yc < node->yc)
-    {
-      // printf("Going left\n");
+  /// Insert the point where a segment enters the sweep across another one, adding it to the U set
+  ///
+  /// Segments entering a slab across its top boundary start there, see
+  /// FindIntersections.
+  /// @param seg ID of the entering line segment
+  /// @param other ID of the segment it crosses at the point
+  void insertEntry(double xc, double yc, unsigned int seg, unsigned int other)
+  {
+    EventQueueNode *node = findOrCreate(xc, yc, seg, other);
+    addSegment(node, seg, 1);
+  }
 
-      node->left = insert(node->left, xc, yc, xs, ys, xe, ye, type);
-    }
-    else if (yc > node->yc)
-    {
-      // printf("Going right\n");
-      node->right = insert(node->right, xc, yc, xs, ys, xe, ye, type);
-    }
-    else if (xc > node->xc)
-    {
-      // printf("Going left\n");
-      node->left = insert(node->left, xc, yc, xs, ys, xe, ye, type);
-    }
-    else if (xc < node->xc)
-    {
-      // printf("Going right\n");
-      node->right = insert(node->right, xc, yc, xs, ys, xe, ye, type);
-    }
-    else
+  /// Insert the crossing of two segments, adding both to its C set with one search
+  /// @param xc X-coordinate of the crossing
+  /// @param yc Y-coordinate of the crossing
+  /// @param a, b IDs of the crossing line segments
+  void insertCrossing(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    EventQueueNode *node = findOrCreate(xc, yc, a, b);
+    addSegment(node, a, 3);
+    addSegment(node, b, 3);
+  }
+
+  /// Find the event point at a point, or link a new one with empty sets into the tree
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  EventQueueNode *findOrCreate(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    EventQueueNode *parent = NULL, *node = root;
+    int c = 0;
+    bool first = true;
+    while (node != NULL)
     {
-      int counter = 1;
-      if (type == 1)
-      {
-        for (int EventQueueNode = 0; EventQueueNode < node->U.size(); EventQueueNode++)
-        {
-          LineSegment l = node->U[EventQueueNode];
-          if (l.startX == xs && l.startY == ys && l.endX == xe && l.endY == ye)
-            counter = 0;
-        }
-        if (counter == 1)
-        {
-          LineSegment *l = new LineSegment;
-          l->startX = xs;
-          l->startY = ys;
-          l->endX = xe;
-          l->endY = ye;
-          node->U.push_back(*l);
-        }
-      }
-      else if (type == 2)
-      {
-        for (int EventQueueNode = 0; EventQueueNode < node->L.size(); EventQueueNode++)
-        {
-          LineSegment l = node->L[EventQueueNode];
-          if (l.startX == xs && l.startY == ys && l.endX == xe && l.endY == ye)
-            counter = 0;
-        }
-        if (counter == 1)
-        {
-          LineSegment *l = new LineSegment;
-          l->startX = xs;
-          l->startY = ys;
-          l->endX = xe;
-          l->endY = ye;
-          node->L.push_back(*l);
-        }
-      }
-      else if (type == 3)
+      c = compare(xc, yc, a, b, node);
+      if (c == 0)
+        return node;
+      parent = node;
+      if (c > 0)
       {
-        for (int EventQueueNode = 0; EventQueueNode < node->C.size(); EventQueueNode++)
-        {
-          LineSegment l = node->C[EventQueueNode];
-          if (l.startX == xs && l.startY == ys && l.endX == xe && l.endY == ye)
-            counter = 0;
-        }
-        if (counter == 1)
-        {
-
-          LineSegment *l = new LineSegment;
-          l->startX = xs;
-          l->startY = ys;
-          l->endX = xe;
-          l->endY = ye;
-          node->C.push_back(*l);
-        }
+        node = node->left;
+        first = false;
       }
-      if (counter == 0)
-        return node;
+      else
+        node = node->right;
     }
 
-    // printf("begin balancing\n");
-    node->height = 1 + max(height(node->left),
-                           height(node->right));
-
-    int balance = getBalance(node);
-
-    if (balance > 1 && mylesser(xc, yc, node->left->xc, node->left->yc))
-      return rightRotate(node);
-
-    if (balance < -1 && mygreater(xc, yc, node->right->xc, node->right->yc))
-      return leftRotate(node);
-
-    if (balance > 1 && mygreater(xc, yc, node->left->xc, node->left->yc))
-    {
-      node->left = leftRotate(node->left);
-      return rightRotate(node);
-    }
-    if (balance < -1 && mylesser(xc, yc, node->right->xc, node->right->yc))
-    {
-      node->right = rightRotate(node->right);
-      return leftRotate(node);
-    }
-    // printf("done balancing\n");
+    node = newNode(xc, yc, a, b);
+    node->parent = parent;
+    if (parent == NULL)
+      root = node;
+    else if (c > 0)
+      parent->left = node;
+    else
+      parent->right = node;
+    if (first)
+      top = node;
+    retrace(parent);
     return node;
   }
 
@@ -321,109 +465,55 @@ public:
     return current;
   }
 
-
-  /// Delete the event point that is to be popped from the event queue
-  EventQueueNode *deleteNode(EventQueueNode *root, double xc, double yc)
+  /// Remove the next event point from the queue
+  ///
+  /// The rightmost node has no right child, so its left subtree takes its
+  /// place. The caller owns the returned point and hands it back through
+  /// release().
+  /// @returns Pointer to the topmost, leftmost event point
+  EventQueueNode *pop()
   {
+    EventQueueNode *node = top;
+    EventQueueNode *parent = node->parent;
+    top = (node->left != NULL) ? maxValueNode(node->left) : parent;
+    replaceChild(node, node->left);
+    retrace(parent);
+    return node;
+  }
 
-    if (root == NULL)
-      return root;
-
-    if (yc < root->yc)
-      root->left = deleteNode(root->left, xc, yc);
-
-    else if (yc > root->yc)
-      root->right = deleteNode(root->right, xc, yc);
-
-    else if (xc > root->xc)
-      root->left = deleteNode(root->left, xc, yc);
-    else if (xc < root->xc)
-      root->right = deleteNode(root->right, xc, yc);
-    else
-    {
-      // node with only one child or no child
-      if ((root->left == NULL) || (root->right == NULL))
-      {
-        EventQueueNode *temp = root->left ? root->left : root->right;
-
-        if (temp == NULL)
-        {
-          // printf("Deleting last element\n");
-          temp = root;
-          root = NULL;
-        }
-        else
-          *root = *temp;
-        free(temp);
-      }
-      else
-      {
-
-        EventQueueNode *temp = minValueNode(root->right);
-
-        // Copy the inorder successor's data to this node
-        root->xc = temp->xc;
-        root->yc = temp->yc;
-        root->U = temp->U;
-        root->C = temp->C;
-        root->L = temp->L;
-        // Delete the inorder successor
-        root->right = deleteNode(root->right, temp->xc, temp->yc);
-      }
-    }
-
-    if (root == NULL)
-      return root;
-
-    root->height = 1 + max(height(root->left),
-                           height(root->right));
-
-    int balance = getBalance(root);
-
-    if (balance > 1 && getBalance(root->left) >= 0)
-      return rightRotate(root);
-
-    if (balance > 1 && getBalance(root->left) < 0)
-    {
-      root->left = leftRotate(root->left);
-      return rightRotate(root);
-    }
-
-    if (balance < -1 && getBalance(root->right) <= 0)
-      return leftRotate(root);
-
-    if (balance < -1 && getBalance(root->right) > 0)
-    {
-      root->right = rightRotate(root->right);
-      return leftRotate(root);
-    }
+  /// Return a popped event point to the pool
+  void release(EventQueueNode *node)
+  {
+    pool->release(node);
+  }
 
-    return root;
+  /// Drop all event points without releasing them
+  ///
+  /// Used when the pool is reset in bulk.
+  void clear()
+  {
+    root = NULL;
+    top = NULL;
   }
   
   /// Print preorder of current tree
-  void preOrder(EventQueueNode *root)
+  void preOrder(EventQueueNode *node)
   {
-    if (root != NULL)
+    if (node != NULL)
     {
-      //printf("%f %f %d\n", root->xc, root->yc, root->height);
-      cout << root->xc << " " << root->yc << " " << root->height << "\n";
+      //printf("%f %f %d\n", node->xc, node->yc, node->height);
+      cout << node->xc << " " << node->yc << " " << node->height << "\n";
 
-      for (size_t i = 0; i < root->U.size(); i++)
-      {
-        //printf(" U:%f %f %f %f\n", root->U[i].startX, root->U[i].startY, root->U[i].endX, root->U[i].endY);
-        cout << root->U[i].startX << " " << root->U[i].startY << " "
-        << root->U[i].endX << " " << root->U[i].endY << "\n";
-      }
+      for (size_t i = 0; i < node->U.size(); i++)
+        cout << " U:" << node->U[i] << "\n";
 
-      for (size_t i = 0; i < root->L.size(); i++)
-      {
-        //printf(" L:%f %f %f %f\n", root->L[i].startX, root->L[i].startY, root->L[i].endX, root->L[i].endY);
-        cout << root->L[i].startX << " " << root->L[i].startY << " "
-        << root->L[i].endX << " " << root->L[i].endY << "\n";
-      }
-      preOrder(root->left);
-      preOrder(root->right);
+      for (size_t i = 0; i < node->L.size(); i++)
+        cout << " L:" << node->L[i] << "\n";
+
+      for (size_t i = 0; i < node->C.size(); i++)
+        cout << " C:" << node->C[i] << "\n";
+      preOrder(node->left);
+      preOrder(node->right);
     }
   }
 };
@@ -1,9 +1,21 @@
+#ifndef FIND_H
+#define FIND_H
+
 #include <algorithm>
 #include <queue>
 #include "StatusQueue.h"
 #include "EventQueue.h"
+#include "FlatStatusQueue.h"
+#include "HeapEventQueue.h"
+#include "IntersectionKernels.h"
+#include "NodePool.h"
+#include "ParallelSort.h"
+#include "Predicates.h"
+#include "SegmentFile.h"
+#include "SweepStats.h"
+#include <atomic>
 #include <iostream>
-#define pdd pair<double, double>
+#include <thread>
 
 using namespace std;
 
@@ -14,125 +26,499 @@ struct Point
     double y;
 };
 
+/// Data structure used to store the status of the sweep line
+enum StatusEngine
+{
+    AVL_STATUS,     //!< Balanced binary search tree (StatusQueue)
+    FLAT_STATUS     //!< Sorted array with a gap buffer (FlatStatusQueue)
+};
+
+/// Data structure used to store the event points
+enum EventEngine
+{
+    AVL_EVENTS,     //!< Balanced binary search tree (EventQueue)
+    HEAP_EVENTS     //!< D-ary heap with a hash table of points (HeapEventQueue)
+};
+
+/// Arithmetic used by the exact predicates of the sweep
+enum CoordinateEngine
+{
+    DOUBLE_COORDINATES,     //!< Adaptive predicates on any double coordinates (Predicates.h)
+    INTEGER_COORDINATES     //!< 128-bit integer predicates on the 32-bit grid (IntegerPredicates.h)
+};
+
+/// Check if every coordinate of a segment source lies on the integer grid
+template<class Source>
+bool onIntegerGrid(const Source &source)
+{
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        const LineSegment s = source[i];
+        if (!integerCoordinate(s.startX) || !integerCoordinate(s.startY) ||
+            !integerCoordinate(s.endX) || !integerCoordinate(s.endY))
+            return false;
+    }
+    return true;
+}
+
+/// Line segment coordinates stored as a structure of arrays
+struct SegmentArrays
+{
+    vector<double> x1;  //!< X-coordinates of the start points
+    vector<double> y1;  //!< Y-coordinates of the start points
+    vector<double> x2;  //!< X-coordinates of the end points
+    vector<double> y2;  //!< Y-coordinates of the end points
+};
+
+/// Structure to represent one pair of intersecting line segments
+///
+/// Segment IDs are positions in the input vector, with a < b.
+struct IntersectionRecord
+{
+    double x;           //!< X-coordinate of the intersection point
+    double y;           //!< Y-coordinate of the intersection point
+    unsigned int a;     //!< ID of the first line segment
+    unsigned int b;     //!< ID of the second line segment
+};
+
+/// Order intersection records by their pair of segment IDs
+inline bool pairBefore(const IntersectionRecord &p, const IntersectionRecord &q)
+{
+    if (p.a != q.a)
+        return p.a < q.a;
+    return p.b < q.b;
+}
+
+/// Visitor that turns every intersection event into one record per pair of segments
+///
+/// Visitors are passed to FindIntersections::runAlgorithm and called inline
+/// from the sweep as `visitor(p, all, line)` for every event point p where
+/// two or more segments meet. p.U, p.L and p.C hold the IDs of the segments
+/// having p as upper endpoint, lower endpoint and interior point, all holds
+/// their union. Every pair of all meets at p for the first time except
+/// collinear overlapping segments, which already met at the upper end of
+/// their overlap: line[i] == line[j] marks such a pair. A visitor declaring
+/// `static const bool usesLines = false` gets an empty line and spares the
+/// sweep the grouping. The call is resolved at compile time. A visitor
+/// returning bool stops the sweep by returning false.
+struct RecordCollector
+{
+    vector<IntersectionRecord> *out;   //!< Records are appended here in sweep order
+
+    RecordCollector(vector<IntersectionRecord> &records) : out(&records) {}
+
+    void operator()(const EventQueueNode &p, const vector<unsigned int> &all, const vector<unsigned int> &line)
+    {
+        for(size_t i = 0; i < all.size(); i++)
+        {
+            for(size_t j = i + 1; j < all.size(); j++)
+            {
+                if (line[i] == line[j])
+                    continue;
+                IntersectionRecord r = {p.xc, p.yc, min(all[i], all[j]), max(all[i], all[j])};
+                out->push_back(r);
+            }
+        }
+    }
+};
+
+/// Segments meeting at every intersection event, in compressed sparse row form
+///
+/// Event k is the point (x[k], y[k]) where the segments ids[offsets[k]] up
+/// to ids[offsets[k + 1] - 1] meet, in increasing ID order. Segment IDs are
+/// positions in the input vector. offsets starts at 0 and has one entry
+/// more than there are events.
+struct IntersectionGroups
+{
+    vector<double> x;           //!< X-coordinates of the event points, in sweep order
+    vector<double> y;           //!< Y-coordinates of the event points, in sweep order
+    vector<size_t> offsets;     //!< Start of the segments of each event in ids, then ids.size()
+    vector<unsigned int> ids;   //!< Segment IDs of all events, concatenated
+
+    /// Number of events
+    size_t size() const
+    {
+        return x.size();
+    }
+};
+
+/// Visitor appending the segments of every intersection event to IntersectionGroups
+///
+/// Every event the sweep reports becomes one group, including the ends of
+/// collinear overlaps where no pair meets for the first time.
+struct GroupCollector
+{
+    static const bool usesLines = false;
+    IntersectionGroups *out;   //!< Groups are appended here in sweep order
+
+    GroupCollector(IntersectionGroups &groups) : out(&groups)
+    {
+        if (out->offsets.empty())
+            out->offsets.push_back(out->ids.size());
+    }
+
+    void operator()(const EventQueueNode &p, const vector<unsigned int> &all, const vector<unsigned int> &)
+    {
+        out->x.push_back(p.xc);
+        out->y.push_back(p.yc);
+        size_t start = out->ids.size();
+        out->ids.insert(out->ids.end(), all.begin(), all.end());
+        sort(out->ids.begin() + start, out->ids.end());
+        out->offsets.push_back(out->ids.size());
+    }
+};
+
+/// Visitor that ignores every intersection event, for timing the bare sweep
+struct NoOpVisitor
+{
+    static const bool usesLines = false;
+    void operator()(const EventQueueNode &, const vector<unsigned int> &, const vector<unsigned int> &) {}
+};
+
+/// Visitor counting the pairs of intersecting segments without storing them
+struct PairCounter
+{
+    size_t pairs = 0;           //!< Pairs counted so far
+    vector<size_t> groupSizes;  //!< Scratch buffer, number of segments on each line
+
+    void operator()(const EventQueueNode &, const vector<unsigned int> &all, const vector<unsigned int> &line)
+    {
+        // every group is named after its first member, so one pass sizes them all
+        groupSizes.assign(line.size(), 0);
+        for(size_t i = 0; i < line.size(); i++)
+            groupSizes[line[i]]++;
+        pairs += all.size() * (all.size() - 1) / 2;
+        for(size_t i = 0; i < groupSizes.size(); i++)
+            pairs -= groupSizes[i] * (groupSizes[i] - 1) / 2;
+    }
+};
+
+/// Visitor stopping the sweep at the first intersection event
+struct FirstIntersection
+{
+    bool found = false;         //!< Whether an intersection was seen
+    IntersectionRecord first;   //!< One pair of segments meeting at the first intersection
+
+    bool operator()(const EventQueueNode &p, const vector<unsigned int> &all, const vector<unsigned int> &line)
+    {
+        for(size_t i = 0; i < all.size(); i++)
+        {
+            for(size_t j = i + 1; j < all.size(); j++)
+            {
+                if (line[i] == line[j])
+                    continue;
+                IntersectionRecord r = {p.xc, p.yc, min(all[i], all[j]), max(all[i], all[j])};
+                first = r;
+                found = true;
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/// Whether a visitor reads the line argument, see RecordCollector
+template<class Visitor>
+constexpr auto visitorUsesLines(int) -> decltype(bool(Visitor::usesLines))
+{
+    return Visitor::usesLines;
+}
+
+/// Visitors that do not say otherwise read the line argument
+template<class Visitor>
+constexpr bool visitorUsesLines(long)
+{
+    return true;
+}
+
+/// Call a visitor that returns bool
+/// @returns false if the visitor asks to stop the sweep
+template<class Visitor>
+auto visitEvent(Visitor &visitor, const EventQueueNode &p, const vector<unsigned int> &all,
+                const vector<unsigned int> &line, int) -> decltype(bool(visitor(p, all, line)))
+{
+    return visitor(p, all, line);
+}
+
+/// Call a visitor that returns nothing
+/// @returns true, such visitors never stop the sweep
+template<class Visitor>
+bool visitEvent(Visitor &visitor, const EventQueueNode &p, const vector<unsigned int> &all,
+                const vector<unsigned int> &line, long)
+{
+    visitor(p, all, line);
+    return true;
+}
+
 class FindIntersections
 {
     private:
-        EventQueue eventQueue;
-        EventQueueNode *eventQueueRoot = NULL;
-        StatusQueue status = StatusQueue();
-        StatusQueueNode *statusRoot = NULL;
+        NodePool<EventQueueNode> eventPool;
+        NodePool<StatusQueueNode> statusPool;
+        vector<LineSegment> segments;   //!< Input segments with the upper endpoint first, indexed by ID
+        SweepOrder order = SweepOrder(&segments);  //!< Exact order of the segments and event points
+        EventQueue eventQueue = EventQueue(&eventPool, &order);
+        HeapEventQueue heapEvents = HeapEventQueue(&eventPool, &order);
+        EventEngine eventEngine;
+        StatusQueue status = StatusQueue(&statusPool, &order);
+        FlatStatusQueue flatStatus = FlatStatusQueue(&order);
+        StatusEngine statusEngine;
+        double windowTop = INFINITY;            //!< Top of the slab swept, segments above it enter there
+        double windowBottom = -INFINITY;        //!< Bottom of the slab swept, the sweep stops there
+        unsigned int bottomLine = NO_SEGMENT;   //!< ID of the horizontal line along the bottom of the slab
+        vector<unsigned int> mark;              //!< Stamp of the last union each segment was added to
+        unsigned int markStamp = 0;             //!< Stamp of the union being built
+        vector<unsigned int> allSegments;       //!< Scratch buffer for Up union Lp union Cp
+        vector<unsigned int> leavingSegments;   //!< Scratch buffer for Lp union Cp
+        vector<unsigned int> enteringSegments;  //!< Scratch buffer for Up union Cp
+        vector<unsigned int> crossingSegments;  //!< Scratch buffer for the status segments through p, Cp
+        vector<unsigned int> segmentLines;      //!< Scratch buffer for the line argument of visitors
+        vector<unsigned int> lineOrder;         //!< Scratch buffer for groupLines
+        SweepStats counters;                    //!< Counters kept by the sweep itself, see stats()
     public:
 
         /// Constructor to initialise event queue and status queue
-        FindIntersections( vector<LineSegment> &segmentVector ){
-            for(size_t i = 0; i < segmentVector.size(); i++)
+        ///
+        /// Segment IDs are positions in segmentVector.
+        /// @param engine Data structure used for the status queue
+        /// @param events Data structure used for the event queue
+        /// @param threads Number of threads used to sort the endpoints, 0 for one per core
+        /// @param coordinates Arithmetic of the predicates, DOUBLE_COORDINATES if any coordinate is off the integer grid
+        FindIntersections( vector<LineSegment> &segmentVector, StatusEngine engine = AVL_STATUS, EventEngine events = AVL_EVENTS, unsigned int threads = 0,
+                           CoordinateEngine coordinates = DOUBLE_COORDINATES ){
+            load(segmentVector, engine, events, threads, coordinates);
+        }
+
+        /// Constructor reading the segments straight from a mapped segment file
+        ///
+        /// Segment IDs are positions in the file.
+        /// @param engine Data structure used for the status queue
+        /// @param events Data structure used for the event queue
+        /// @param threads Number of threads used to sort the endpoints, 0 for one per core
+        /// @param coordinates Arithmetic of the predicates, DOUBLE_COORDINATES if any coordinate is off the integer grid
+        FindIntersections( const MappedSegmentFile &file, StatusEngine engine = AVL_STATUS, EventEngine events = AVL_EVENTS, unsigned int threads = 0,
+                           CoordinateEngine coordinates = DOUBLE_COORDINATES ){
+            load(file, engine, events, threads, coordinates);
+        }
+
+        /// Constructor for the part of a sweep inside the horizontal slab bottom < y <= top
+        ///
+        /// The segments keep their exact coordinates. Those starting above the
+        /// slab enter it where they cross y = top, and the sweep stops before
+        /// the first event point at or below y = bottom. The events reported
+        /// are then exactly those of the whole sweep lying in the slab, except
+        /// that collinear segments both entering across the top already met
+        /// above it. No endpoint may lie on a boundary. See SlabIntersections.
+        /// @param top, bottom Boundaries of the slab, INFINITY or -INFINITY for none
+        FindIntersections( vector<LineSegment> &segmentVector, double top, double bottom,
+                           StatusEngine engine = AVL_STATUS, EventEngine events = AVL_EVENTS ){
+            windowTop = top;
+            windowBottom = bottom;
+            load(segmentVector, engine, events, 1, DOUBLE_COORDINATES);
+        }
+
+    private:
+        /// Initialise event queue and status queue from any indexable segment source
+        template<class Source>
+        void load( const Source &source, StatusEngine engine, EventEngine events, unsigned int threads,
+                   CoordinateEngine coordinates ){
+            statusEngine = engine;
+            eventEngine = events;
+            order.integer = coordinates == INTEGER_COORDINATES && onIntegerGrid(source);
+            segments.resize(source.size());
+            mark.assign(source.size(), 0);
+            eventQueue.reserveSegments(source.size());
+            heapEvents.reserveSegments(source.size());
+            status.reserveSegments(source.size());
+            vector<Endpoint> endpoints;
+            endpoints.reserve(2 * source.size());
+            vector<unsigned int> entering;
+            for(size_t i = 0; i < source.size(); i++)
             {   
-                float startx, starty, endx, endy;
-                if(segmentVector[i].startY >= segmentVector[i].endY){
-                    startx = segmentVector[i].startX;
-                    starty = segmentVector[i].startY;
-                    endx = segmentVector[i].endX;
-                    endy = segmentVector[i].endY;
+                const LineSegment input = source[i];
+                double startx, starty, endx, endy;
+                if(input.startY >= input.endY){
+                    startx = input.startX;
+                    starty = input.startY;
+                    endx = input.endX;
+                    endy = input.endY;
                 } else {
-                    startx = segmentVector[i].endX;
-                    starty = segmentVector[i].endY;
-                    endx = segmentVector[i].startX;
-                    endy = segmentVector[i].startY;
+                    startx = input.endX;
+                    starty = input.endY;
+                    endx = input.startX;
+                    endy = input.startY;
                 }
-                if (segmentVector[i].startY == segmentVector[i].endY ) {
-                    if (segmentVector[i].startX <= segmentVector[i].endX) {
-                        startx = segmentVector[i].startX;
-                        starty = segmentVector[i].startY;
-                        endx = segmentVector[i].endX;
-                        endy = segmentVector[i].endY;
+                if (input.startY == input.endY ) {
+                    if (input.startX <= input.endX) {
+                        startx = input.startX;
+                        starty = input.startY;
+                        endx = input.endX;
+                        endy = input.endY;
                     } else {
-                        startx = segmentVector[i].endX;
-                        starty = segmentVector[i].endY;
-                        endx = segmentVector[i].startX;
-                        endy = segmentVector[i].startY;
+                        startx = input.endX;
+                        starty = input.endY;
+                        endx = input.startX;
+                        endy = input.startY;
                     }
                     
                 }
                 
                 // printf("%f %f %f %f\n", startx, starty, endx, endy);             
                 
-                // insert end points into the EventQueue queue.
-                eventQueueRoot = eventQueue.insert( eventQueueRoot, startx, starty, startx, starty, endx, endy, 1);
-                eventQueueRoot = eventQueue.insert( eventQueueRoot, endx, endy, startx, starty, endx, endy, 2);
+                segments[i].startX = startx;
+                segments[i].startY = starty;
+                segments[i].endX = endx;
+                segments[i].endY = endy;
+
+                Endpoint upper = {startx, starty, (unsigned int)i, 1};
+                Endpoint lower = {endx, endy, (unsigned int)i, 2};
+                if (starty > windowTop)
+                    entering.push_back((unsigned int)i);
+                else
+                    endpoints.push_back(upper);
+                if (endy > windowBottom)
+                    endpoints.push_back(lower);
+            }
+
+            // sort the end points once and build the event queue in one pass
+            parallelSort(endpoints, endpointBefore, threads);
+            if (eventEngine == HEAP_EVENTS)
+                heapEvents.bulkLoad(endpoints);
+            else
+                eventQueue.bulkLoad(endpoints);
+            SWEEP_ADD(counters, eventInserts, eventSerial() - 1);
+            if (windowTop != INFINITY || windowBottom != -INFINITY)
+                openWindow(entering);
+        }
+
+        /// Add the boundaries of the slab as horizontal lines, and queue the segments entering across the top
+        ///
+        /// A segment enters at its exact crossing with the top line, which is
+        /// an event point like any other crossing, with the segment in its Up.
+        /// @param entering Segments starting above the slab
+        void openWindow(const vector<unsigned int> &entering){
+            LineSegment top = {0, (Coordinate)windowTop, 1, (Coordinate)windowTop};
+            LineSegment bottom = {0, (Coordinate)windowBottom, 1, (Coordinate)windowBottom};
+            unsigned int topLine = (unsigned int)segments.size();
+            segments.push_back(top);
+            bottomLine = (unsigned int)segments.size();
+            segments.push_back(bottom);
+
+            for(size_t i = 0; i < entering.size(); i++)
+            {
+                const LineSegment &l = segments[entering[i]];
+                double x, y;
+                intersectionPoint(l.startX, l.startY, l.endX, l.endY, top.startX, top.startY, top.endX, top.endY, x, y);
+                eventInsertEntry(x, y, entering[i], topLine);
             }
         }
 
+        /// Check if an event point lies above the bottom of the slab swept
+        bool aboveWindow(EventQueueNode *p){
+            if (p->yc != windowBottom)
+                return p->yc > windowBottom;
+            if (order.exactEventY(p->a, p->b))
+                return false;
+            // the rounded point is on the line, only the exact one tells
+            order.moveTo(p->xc, p->yc, p->a, p->b);
+            return order.side(segments[bottomLine], bottomLine) > 0;
+        }
 
-        /// Given three collinear points p, q, r, the function checks if
-        /// point q lies on line segment 'pr'.
-        bool onSegment(Point p, Point q, Point r) 
-        { 
-            if (q.x <= max(p.x, r.x) && q.x >= min(p.x, r.x) && 
-                q.y <= max(p.y, r.y) && q.y >= min(p.y, r.y)) 
-            return true; 
-        
-            return false; 
-        } 
+    public:
 
+        /// Serial number the selected event queue hands to its next event point
+        unsigned int eventSerial(){
+            return (eventEngine == HEAP_EVENTS) ? heapEvents.nextSerial : eventQueue.nextSerial;
+        }
 
-        /// To find orientation of ordered triplet (p, q, r). 
+        /// Insert a point into the selected event queue
+        /// @param other For intersection points, ID of the other line segment crossing there
+        /// @returns true if a new event point was created, false if the point was already queued
+        bool eventInsert(double xc, double yc, unsigned int seg, int type, unsigned int other = NO_SEGMENT){
+            unsigned int serial = eventSerial();
+            if (eventEngine == HEAP_EVENTS)
+                heapEvents.insert(xc, yc, seg, type, other);
+            else
+                eventQueue.insert(xc, yc, seg, type, other);
+            bool created = eventSerial() != serial;
+            if (created)
+                SWEEP_COUNT(counters, eventInserts);
+            else
+                SWEEP_COUNT(counters, eventMerges);
+            return created;
+        }
+
+        /// Insert the crossing of two segments into the selected event queue with one search
+        /// @returns true if a new event point was created, false if the point was already queued
+        bool eventInsertCrossing(double xc, double yc, unsigned int sl, unsigned int sr){
+            unsigned int serial = eventSerial();
+            if (eventEngine == HEAP_EVENTS)
+                heapEvents.insertCrossing(xc, yc, sl, sr);
+            else
+                eventQueue.insertCrossing(xc, yc, sl, sr);
+            bool created = eventSerial() != serial;
+            if (created)
+                SWEEP_COUNT(counters, eventInserts);
+            else
+                SWEEP_COUNT(counters, eventMerges);
+            return created;
+        }
+
+        /// Insert the point where a segment enters the sweep across another one into the selected event queue
+        /// @returns true if a new event point was created, false if the point was already queued
+        bool eventInsertEntry(double xc, double yc, unsigned int seg, unsigned int other){
+            unsigned int serial = eventSerial();
+            if (eventEngine == HEAP_EVENTS)
+                heapEvents.insertEntry(xc, yc, seg, other);
+            else
+                eventQueue.insertEntry(xc, yc, seg, other);
+            bool created = eventSerial() != serial;
+            if (created)
+                SWEEP_COUNT(counters, eventInserts);
+            else
+                SWEEP_COUNT(counters, eventMerges);
+            return created;
+        }
+
+        /// Check if the selected event queue has no event points left
+        bool eventEmpty(){
+            return (eventEngine == HEAP_EVENTS) ? heapEvents.empty() : eventQueue.empty();
+        }
+
+        /// Remove the next event point from the selected event queue
         ///
-        /// @returns 0 if p, q and r are collinear 
-        /// @returns 1 if they are in clockwise orientation
-        /// @returns 2 if they are in ounterclockwise orientation
-        int orientation(Point p, Point q, Point r) 
-        { 
-            float val = (q.y - p.y) * (r.x - q.x) - 
-                    (q.x - p.x) * (r.y - q.y); 
-        
-            if (val == 0) return 0;  // collinear 
-        
-            return (val > 0)? 1: 2; // clock or counterclock wise 
-        } 
+        /// The point goes back to the pool through eventPool.release().
+        EventQueueNode *eventPop(){
+            return (eventEngine == HEAP_EVENTS) ? heapEvents.pop() : eventQueue.pop();
+        }
 
 
        /// Check if two line segments 'l1' and 'l2' intersect.
+       ///
+       /// Touching segments intersect; the test is exact.
        /// @returns *true* if they intersect
        /// @returns *false* if they do not intersect
-        bool doIntersect(LineSegment l1, LineSegment l2)
+        bool doIntersect(const LineSegment &l1, const LineSegment &l2)
         { 
-            struct Point p1, q1, p2, q2;
-            p1.x = l1.startX;
-            p1.y = l1.startY;
-            q1.x = l1.endX;
-            q1.y = l1.endY;
-            p2.x = l2.startX;
-            p2.y = l2.startY;
-            q2.x = l2.endX;
-            q2.y = l2.endY;
-            // Find the four orientations needed for general and special cases 
-            int o1 = orientation(p1, q1, p2); 
-            int o2 = orientation(p1, q1, q2); 
-            int o3 = orientation(p2, q2, p1); 
-            int o4 = orientation(p2, q2, q1); 
-        
-            // General case 
-            if (o1 != o2 && o3 != o4) 
-                return true; 
-        
-            // Special Cases 
-            // p1, q1 and p2 are collinear and p2 lies on segment p1q1 
-            if (o1 == 0 && onSegment(p1, p2, q1)) return true; 
-        
-            // p1, q1 and q2 are collinear and q2 lies on segment p1q1 
-            if (o2 == 0 && onSegment(p1, q2, q1)) return true; 
-        
-            // p2, q2 and p1 are collinear and p1 lies on segment p2q2 
-            if (o3 == 0 && onSegment(p2, p1, q2)) return true; 
-        
-            // p2, q2 and q1 are collinear and q1 lies on segment p2q2 
-            if (o4 == 0 && onSegment(p2, q1, q2)) return true; 
-        
-            return false; // Doesn't fall in any of the above cases 
+            if (order.integer)
+                return segmentsIntersectInteger(l1.startX, l1.startY, l1.endX, l1.endY,
+                                                l2.startX, l2.startY, l2.endX, l2.endY);
+            return segmentsIntersect(l1.startX, l1.startY, l1.endX, l1.endY,
+                                     l2.startX, l2.startY, l2.endX, l2.endY);
         } 
 
+        /// Check if two line segments are parallel, collinear ones included
+        bool parallel(const LineSegment &l1, const LineSegment &l2)
+        {
+            return order.turn(l1, l2) == 0;
+        }
+
         /// Find the intersection point of two line segments if they intersect
-        Point intersectionOf(LineSegment l1, LineSegment l2){
+        ///
+        /// Crossing points are rounded to the nearest doubles. Collinear
+        /// overlapping segments give the topmost point they share, the one
+        /// the sweep reaches first.
+        Point intersectionOf(const LineSegment &l1, const LineSegment &l2){
             
             Point intersection;
             if (doIntersect(l1, l2) == 0) 
@@ -141,556 +527,494 @@ class FindIntersections
                 intersection.x = -1;
                 intersection.y = -1;
             } 
+            else if (parallel(l1, l2))
+            {
+                // the overlap starts at the upper endpoint popped last
+                Point u1 = upperEndpoint(l1), u2 = upperEndpoint(l2);
+                bool first = (u1.y != u2.y) ? u1.y > u2.y : u1.x < u2.x;
+                intersection = first ? u2 : u1;
+            }
             else
             {   
-                // Line l1 represented as a1x + b1y = c1 
-                double a1 = l1.endY - l1.startY; 
-                double b1 = l1.startX - l1.endX; 
-                double c1 = a1*(l1.startX) + b1*(l1.startY); 
-            
-                // Line l2 represented as a2x + b2y = c2 
-                double a2 = l2.endY - l2.startY; 
-                double b2 = l2.startX - l2.endX; 
-                double c2 = a2*(l2.startX) + b2*(l2.startY); 
-            
-                double determinant = a1*b2 - a2*b1; 
-                intersection.x = (b2*c1 - b1*c2)/determinant; 
-                intersection.y = (a1*c2 - a2*c1)/determinant;
+                intersectionPoint(l1.startX, l1.startY, l1.endX, l1.endY,
+                                  l2.startX, l2.startY, l2.endX, l2.endY,
+                                  intersection.x, intersection.y);
             }
             return intersection;
         }
 
+        /// Endpoint of a line segment that the sweep reaches first
+        static Point upperEndpoint(const LineSegment &l)
+        {
+            Point start = {l.startX, l.startY}, end = {l.endX, l.endY};
+            if (l.startY != l.endY)
+                return (l.startY > l.endY) ? start : end;
+            return (l.startX <= l.endX) ? start : end;
+        }
+
         /// Insert the new event point resulting from the intersection of two line segments 'sl' and 'sr'
-        void findNewEvent(LineSegment sl, LineSegment sr, EventQueueNode* p){
+        ///
+        /// Collinear segments are skipped: they meet at an endpoint of one of
+        /// them, where the status search of handleEventPoint finds them.
+        void findNewEvent(unsigned int sl, unsigned int sr, EventQueueNode* p){
             // find intersection Point of sl and sr
-            struct Point newEventPoint = intersectionOf(sl, sr);
-            // printf("intersection Point of %f %f %f %f AND %f %f %f %f: %f %f\n", sl.startX, sl.startY, sl.endX, sl.endY, sr.startX, sr.startY, sr.endX, sr.endY, newEventPoint.x, newEventPoint.y);
-            if (newEventPoint.y != -1) {
-                if(newEventPoint.y < p->yc){
-                    eventQueueRoot = eventQueue.insert( eventQueueRoot, newEventPoint.x, newEventPoint.y, sl.startX, sl.startY, sl.endX, sl.endY, 3);
-                    eventQueueRoot = eventQueue.insert( eventQueueRoot, newEventPoint.x, newEventPoint.y, sr.startX, sr.startY, sr.endX, sr.endY, 3);
-                } else if(newEventPoint.y == p->yc && newEventPoint.x > p->xc){
-                    eventQueueRoot = eventQueue.insert( eventQueueRoot, newEventPoint.x, newEventPoint.y, sl.startX, sl.startY, sl.endX, sl.endY, 3);
-                    eventQueueRoot = eventQueue.insert( eventQueueRoot, newEventPoint.x, newEventPoint.y, sr.startX, sr.startY, sr.endX, sr.endY, 3);
-                }
+            SWEEP_COUNT(counters, findNewEvents);
+            const LineSegment &l1 = segments[sl], &l2 = segments[sr];
+            if (!doIntersect(l1, l2) || parallel(l1, l2))
+                return;
+            struct Point newEventPoint;
+            intersectionPoint(l1.startX, l1.startY, l1.endX, l1.endY, l2.startX, l2.startY, l2.endX, l2.endY,
+                              newEventPoint.x, newEventPoint.y);
+            if(order.compareEvents(newEventPoint.x, newEventPoint.y, sl, sr, p->xc, p->yc, p->a, p->b) > 0){
+                bool created = eventInsertCrossing(newEventPoint.x, newEventPoint.y, sl, sr);
+                if (created)
+                    SWEEP_COUNT(counters, newEvents);
+                else
+                    SWEEP_COUNT(counters, duplicateEvents);
             }
-            
         }
 
-        /// Check if a line segment is in a vector of line segments
-        /// @param x Vector of line segments
-        /// @param l Line segment to be checked
-        /// @returns 0 if the vector x contains line segment l
-        /// @returns 1 if the vector x doesn't contain line segment l
-        int contains(vector<LineSegment> x, LineSegment l){
-            for(size_t i = 0; i < x.size(); i++)
-            {
-                if(x[i].startX == l.startX && x[i].startY == l.startY && x[i].endX == l.endX && x[i].endY == l.endY){
-                    return 0;
-                }
+        /// Start a new stamp for the mark array
+        void nextStamp(){
+            if (++markStamp == 0) {
+                // stamp wrapped around, forget all old stamps
+                fill(mark.begin(), mark.end(), 0);
+                markStamp = 1;
             }
-            return 1;
         }
 
-        /// Find the union of two vectors of line segments 'a' and 'b'
-        /// @returns Vector containing all line segments in the union of 'a' and 'b'
-        vector<LineSegment> unionOf(vector<LineSegment> a, vector<LineSegment> b){
-            vector<LineSegment> unionVec;
+        /// Find the union of two vectors of line segment IDs 'a' and 'b'
+        ///
+        /// Runs in O(|a| + |b|) by stamping every segment added to the union.
+        /// @param out Buffer receiving all line segment IDs in the union of 'a' and 'b'
+        void unionOf(const vector<unsigned int> &a, const vector<unsigned int> &b, vector<unsigned int> &out){
+            out.clear();
+            nextStamp();
             for(size_t i = 0; i < a.size(); i++)
             {
-                unionVec.push_back(a[i]);
+                if(mark[a[i]] != markStamp){
+                    mark[a[i]] = markStamp;
+                    out.push_back(a[i]);
+                }
             }
             for(size_t i = 0; i < b.size(); i++)
             {
-                if(contains(unionVec, b[i]) == 1){
-                    unionVec.push_back(b[i]);
+                if(mark[b[i]] != markStamp){
+                    mark[b[i]] = markStamp;
+                    out.push_back(b[i]);
                 }
             }
-            return unionVec;
         }
 
-        // Check if a vector of line segments 'x' is empty
-        // int empty(vector<LineSegment> x){
-        //     if(x.size() == 0){
-        //         return 1;
-        //     } else {
-        //         return 0;
-        //     }
-        // }
+        /// Insert a line segment into the selected status queue
+        void statusInsert(unsigned int l){
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.insert(l);
+            else
+                status.insert(l);
+        }
+
+        /// Delete a line segment from the selected status queue
+        void statusDelete(unsigned int l){
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.deleteNode(l);
+            else
+                status.deleteNode(l);
+        }
 
-        /// Handle each event queue point popped from the event queue
-        void handleEventPoint(EventQueueNode* eventPoint){
+        /// Move the segments through the event point to their order just below it in the selected status queue
+        /// @param ids All the segments of the queue through the point, left to right
+        void statusReorder(const vector<unsigned int> &ids){
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.reorder(ids);
+            else
+                status.reorder(ids);
+        }
+
+        /// Get the left neighbor of a line segment from the selected status queue
+        void statusLeftNeighbor(unsigned int l, unsigned int *lastRight){
+            SWEEP_COUNT(counters, neighborLookups);
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.getLeftNeighbor(l, lastRight);
+            else
+                status.getLeftNeighbor(l, lastRight);
+        }
+
+        /// Get the right neighbor of a line segment from the selected status queue
+        void statusRightNeighbor(unsigned int l, unsigned int *lastLeft){
+            SWEEP_COUNT(counters, neighborLookups);
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.getRightNeighbor(l, lastLeft);
+            else
+                status.getRightNeighbor(l, lastLeft);
+        }
 
-            // Union of Lp, Up and Cp
-            vector<LineSegment> all = unionOf(eventPoint->L, unionOf(eventPoint->U, eventPoint->C));
+        /// Get left and right neighbouring segments of the event point from the selected status queue
+        void statusNeighbors(unsigned int *lastRight, unsigned int *lastLeft){
+            SWEEP_COUNT(counters, neighborLookups);
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.getNeighbors(lastRight, lastLeft);
+            else
+                status.getNeighbors(lastRight, lastLeft);
+        }
+
+        /// Collect the segments of the selected status queue passing through the event point
+        void statusContaining(vector<unsigned int> &out){
+            if (statusEngine == FLAT_STATUS)
+                flatStatus.containing(out);
+            else
+                status.containing(out);
+        }
+
+        /// Group the segments meeting at an event point by the line they reached it on
+        ///
+        /// Each segment starting at p is a group of its own. The others came from
+        /// above, and collinear ones among them share a group, see RecordCollector.
+        /// They all point downwards through p, so sorting them by direction
+        /// brings every group together in O(k log k).
+        /// @param all Segments meeting at the event point, the ones starting there marked with the current stamp
+        /// @param line Receives the group of every entry, the index of its first member
+        void groupLines(const vector<unsigned int> &all, vector<unsigned int> &line){
+            line.resize(all.size());
+            vector<unsigned int> &above = lineOrder;
+            above.clear();
+            for(size_t i = 0; i < all.size(); i++)
+            {
+                line[i] = (unsigned int)i;
+                if (mark[all[i]] != markStamp)
+                    above.push_back((unsigned int)i);
+            }
+            if (above.size() < 2)
+                return;
+
+            // from pointing left round to pointing right, ties by position in all
+            sort(above.begin(), above.end(), [&](unsigned int i, unsigned int j) {
+                int c = order.turn(segments[all[i]], segments[all[j]]);
+                return (c != 0) ? c > 0 : i < j;
+            });
+            for(size_t k = 1; k < above.size(); k++)
+            {
+                if (parallel(segments[all[above[k - 1]]], segments[all[above[k]]]))
+                    line[above[k]] = line[above[k - 1]];
+            }
+        }
+
+        /// Handle each event queue point popped from the event queue
+        ///
+        /// Cp is completed with every status segment through the point, so
+        /// endpoints lying on other segments and segments meeting at an
+        /// already passed point are handled too.
+        /// @param visitor Called with the event point if it is an intersection
+        /// @returns false if the visitor stopped the sweep
+        template<class Visitor>
+        bool handleEventPoint(EventQueueNode* eventPoint, Visitor &visitor){
+            order.moveTo(eventPoint->xc, eventPoint->yc, eventPoint->a, eventPoint->b);
+
+            // Cp: segments through p other than the ones ending there
+            vector<unsigned int> &found = crossingSegments;
+            found.clear();
+            statusContaining(found);
+            found.insert(found.end(), eventPoint->C.begin(), eventPoint->C.end());
+            vector<unsigned int> &temp1 = leavingSegments;
+            unionOf(eventPoint->L, found, temp1);
+            found.assign(temp1.begin() + eventPoint->L.size(), temp1.end());
+
+            // Up union Cp without zero length segments, which also are in Lp
+            vector<unsigned int> &temp2 = enteringSegments;
+            temp2.clear();
+            for(size_t i = 0; i < eventPoint->U.size(); i++)
+            {
+                if (mark[eventPoint->U[i]] != markStamp)
+                    temp2.push_back(eventPoint->U[i]);
+            }
+            temp2.insert(temp2.end(), found.begin(), found.end());
+
+            // Lp union Cp union Up, with the segments starting at p stamped for groupLines
+            vector<unsigned int> &all = allSegments;
+            all.assign(temp1.begin(), temp1.end());
+            all.insert(all.end(), temp2.begin(), temp2.end() - found.size());
+            nextStamp();
+            for(size_t i = 0; i < eventPoint->U.size(); i++)
+            {
+                // a segment entering a slab across its top came from above
+                if (segments[eventPoint->U[i]].startY <= windowTop)
+                    mark[eventPoint->U[i]] = markStamp;
+            }
 
             if (all.size() > 1) {
-                // p is an intersection
-                printf("Intersection: %f %f\n", eventPoint->xc, eventPoint->yc);
+                // p is an intersection, hand it over before the status changes
+                if (visitorUsesLines<Visitor>(0))
+                    groupLines(all, segmentLines);
+                else
+                    segmentLines.clear();
+                if (!visitEvent(visitor, *eventPoint, all, segmentLines, 0))
+                    return false;
             }
-            // delete elements of Lp union Cp from status
-            vector<LineSegment> temp1 = unionOf(eventPoint->L, eventPoint->C);
-            for(size_t i = 0; i < temp1.size(); i++)
+            // delete elements of Lp from status
+            for(size_t i = 0; i < eventPoint->L.size(); i++)
             {
-                // printf("delete line: %f %f %f %f\n",temp1[i].startX,temp1[i].startY, temp1[i].endX, temp1[i].endY);
-                statusRoot = status.deleteNode(statusRoot, temp1[i], eventPoint->yc);
+                statusDelete(temp1[i]);
             }
-            // printf("Point: %f %f\n", eventPoint->xc, eventPoint->yc);
-            // printf("after deleting:\n");
-            // status.preOrder(statusRoot);
-            
-            // insert segments in Up union Cp into status according to their position just below the sweep line
-            vector<LineSegment> temp2 = unionOf(eventPoint->U, eventPoint->C);
-            for(size_t i = 0; i < temp2.size(); i++)
+
+            // Cp is what is left of the run through p, reorder it where it lies
+            statusReorder(found);
+
+            // insert segments in Up into status according to their position just below the sweep line
+            for(size_t i = 0; i + found.size() < temp2.size(); i++)
             {
-                statusRoot = status.insert(statusRoot, temp2[i], (eventPoint->yc - 0.1));
+                statusInsert(temp2[i]);
             }
-            // printf("after reinserting:\n");
-            // status.preOrder(statusRoot);
 
             // check if Up union Cp is empty
             if(temp2.empty() == 1){
-                struct LineSegment sl, sr;
-                sl.startX = -1;
-                sr.startX = -1;
-                // status.preOrder(statusRoot);
-                status.getNeighbors(statusRoot, eventPoint->xc, (eventPoint->yc)-0.1, &sl, &sr);
-                // if(sl.startX != -1){
-                //     if (sr.startX != -1) {
-                //         findNewEvent(sl, sr, eventPoint);
-                //     }
-                // }
+                unsigned int sl = NO_SEGMENT, sr = NO_SEGMENT;
+                statusNeighbors(&sl, &sr);
+                if(sl != NO_SEGMENT && sr != NO_SEGMENT){
+                    findNewEvent(sl, sr, eventPoint);
+                }
             } else {
-                struct LineSegment sll, srr;
-                float max = -1.0, min = 1001.0; 
-                for(size_t i = 0; i < temp2.size(); i++)
+                // leftmost and rightmost of Up union Cp just below p
+                unsigned int sll = temp2[0], srr = temp2[0];
+                for(size_t i = 1; i < temp2.size(); i++)
                 {
-                    float x = status.findx(temp2[i], eventPoint->yc);
-                    float minX = (temp2[i].startX < temp2[i].endX) ? temp2[i].startX : temp2[i].endX;
-                    float maxX = (temp2[i].startX > temp2[i].endX) ? temp2[i].startX : temp2[i].endX;
-                    if (x < min && x <= maxX && x >= minX) {
-                        min = x;
+                    if (order.compareBelow(temp2[i], sll) < 0)
                         sll = temp2[i];
-                    }
-                    if(x > max  && x <= maxX && x >= minX){
-                        
-                        max = x;
+                    if (order.compareBelow(temp2[i], srr) > 0)
                         srr = temp2[i];
-                    }
-                    
                 }
   
-                struct LineSegment sl, sr;
-                sl.startX = -1;
-                sr.startX = -1;
-                status.getLeftNeighbor(statusRoot, sll, eventPoint->yc, &sl);
-                status.getRightNeighbor(statusRoot , srr, eventPoint->yc, &sr);
+                unsigned int sl = NO_SEGMENT, sr = NO_SEGMENT;
+                statusLeftNeighbor(sll, &sl);
+                statusRightNeighbor(srr, &sr);
                 
-                if(sl.startX != -1 && min != 1001){
+                if(sl != NO_SEGMENT){
                     findNewEvent(sl, sll, eventPoint);
                 }
-                if(sr.startX != -1 && max != -1){
+                if(sr != NO_SEGMENT){
                     findNewEvent(srr, sr, eventPoint);
                 }
             }
-            
+            return true;
+        }
 
+        /// Record the sizes and heights of the queues before an event is handled
+        void sampleQueues(){
+#ifdef SWEEP_STATS
+            SWEEP_COUNT(counters, events);
+            SWEEP_COUNT(counters, eventDeletes);
+            if (eventEngine == HEAP_EVENTS) {
+                SWEEP_MAX(counters, maxEventQueueSize, heapEvents.heap.size() + 1);
+                SWEEP_MAX(counters, maxEventHeight, heapEvents.height());
+            } else {
+                SWEEP_MAX(counters, maxEventQueueSize, eventPool.size());
+                SWEEP_MAX(counters, maxEventHeight, eventQueue.height());
+            }
+            if (statusEngine == FLAT_STATUS) {
+                SWEEP_MAX(counters, maxStatusSize, flatStatus.size());
+            } else {
+                // every segment is a leaf and the tree is full, so it has 2n - 1 nodes
+                SWEEP_MAX(counters, maxStatusSize, (statusPool.size() + 1) / 2);
+                SWEEP_MAX(counters, maxStatusHeight, status.height());
+            }
+#endif
         }
 
-        /// Run the algorithm to find the line intersections
-        void runAlgorithm(){
-            while(eventQueueRoot != NULL){
-                EventQueueNode* pop = eventQueue.maxValueNode(eventQueueRoot);
-                if (pop != NULL) {
-                   handleEventPoint(pop); 
-                   eventQueueRoot = eventQueue.deleteNode(eventQueueRoot, pop->xc, pop-> yc);
+        /// Run the algorithm and stream the intersections to a visitor
+        ///
+        /// Consumes the event queue, so it can be run once per object. See
+        /// RecordCollector for the calls made on the visitor; the sweep ends
+        /// early if the visitor returns false.
+        /// @param visitor Called for every intersection event, in sweep order
+        template<class Visitor>
+        void runAlgorithm(Visitor &visitor){
+            while(!eventEmpty()){
+                // popping first is safe, new events always lie below the popped point
+                EventQueueNode* pop = eventPop();
+                if (!aboveWindow(pop)) {
+                    eventPool.release(pop);
+                    break;
                 }
-                
+                sampleQueues();
+                bool more = handleEventPoint(pop, visitor);
+                eventPool.release(pop);
+                if (!more)
+                    break;
             }
-            cout << "\nExecution complete\n";
+            // reclaim every node of both trees in bulk
+            status.clear();
+            flatStatus.clear();
+            eventQueue.clear();
+            heapEvents.clear();
+            eventPool.reset();
+            statusPool.reset();
         }
 
+        /// Run the algorithm to find the line intersections
+        /// @param out Receives one record per pair of intersecting segments, in sweep order
+        void runAlgorithm(vector<IntersectionRecord> &out){
+            RecordCollector collector(out);
+            runAlgorithm(collector);
+        }
 
+        /// Run the algorithm and collect the segments meeting at every intersection event
+        /// @param out Receives one group per event, in sweep order
+        void runAlgorithm(IntersectionGroups &out){
+            GroupCollector collector(out);
+            runAlgorithm(collector);
+        }
 
+        /// Run the algorithm to find the line intersections
+        /// @returns One record per pair of intersecting segments, in sweep order
+        vector<IntersectionRecord> runAlgorithm(){
+            vector<IntersectionRecord> out;
+            runAlgorithm(out);
+            return out;
+        }
 
+        /// Count the pairs of intersecting segments without storing them
+        ///
+        /// Consumes the event queue like runAlgorithm.
+        size_t countIntersections(){
+            PairCounter counter;
+            runAlgorithm(counter);
+            return counter.pairs;
+        }
 
+        /// Check if any two segments intersect, stopping at the first intersection found
+        ///
+        /// Consumes the event queue like runAlgorithm.
+        /// @param witness Receives one intersecting pair if there is one, may be NULL
+        bool anyIntersection(IntersectionRecord *witness = NULL){
+            FirstIntersection first;
+            runAlgorithm(first);
+            if (first.found && witness != NULL)
+                *witness = first.first;
+            return first.found;
+        }
 
+        /// Arithmetic the predicates of this sweep use
+        CoordinateEngine coordinateEngine(){
+            return order.integer ? INTEGER_COORDINATES : DOUBLE_COORDINATES;
+        }
 
+        /// Counters of the work done so far, all zero unless compiled with SWEEP_STATS
+        SweepStats stats(){
+            SweepStats all = counters;
+            all.merge(eventQueue.stats);
+            all.merge(status.stats);
+            all.merge(flatStatus.stats);
+            all.merge(order.stats);
+            return all;
+        }
 
+        /// Peak number of bytes held by the event and status tree nodes
+        size_t peakMemory(){
+            return eventPool.peakBytes() + statusPool.peakBytes();
+        }
 
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-    pdd lineLineIntersection(pdd A, pdd B, pdd C, pdd D)
+  /// Run the brute force algorithm on one tile of segment pairs
+  ///
+  /// Checks every pair (i, j) with i in [i0, i1), j in [j0, j1) and i < j,
+  /// testing segment i against a whole row of the tile with one kernel call.
+  void bruteForceTile(const SegmentArrays &segs, IntersectKernel kernel, size_t i0, size_t i1, size_t j0, size_t j1,
+                      vector<unsigned int> &candidates, vector<IntersectionRecord> &hits)
   {
-    // Line AB represented as a1x + b1y = c1
-    double a1 = B.second - A.second;
-    double b1 = A.first - B.first;
-    double c1 = a1 * (A.first) + b1 * (A.second);
-
-    // Line CD represented as a2x + b2y = c2
-    double a2 = D.second - C.second;
-    double b2 = C.first - D.first;
-    double c2 = a2 * (C.first) + b2 * (C.second);
-
-    double determinant = a1 * b2 - a2 * b1;
-
-    if (determinant == 0)
-    {
-      // The lines are parallel. This is simplified
-      // by returning a pair of FLT_MAX
-      return make_pair(-1, -1);
-    }
-    else
+    for (size_t i = i0; i < i1; i++)
     {
-      double x = (b2 * c1 - b1 * c2) / determinant;
-      double y = (a1 * c2 - a2 * c1) / determinant;
-      return make_pair(x, y);
+      size_t first = max(j0, i + 1);
+      if (first >= j1)
+        continue;
+
+      double ax = segs.x1[i], ay = segs.y1[i], bx = segs.x2[i], by = segs.y2[i];
+      candidates.resize(j1 - first);
+      size_t count = kernel(ax, ay, bx, by, &segs.x1[first], &segs.y1[first], &segs.x2[first], &segs.y2[first],
+                            j1 - first, (unsigned int)first, &candidates[0]);
+
+      // the arrays hold the stored coordinates widened, so narrowing them back is exact
+      LineSegment li = {(Coordinate)ax, (Coordinate)ay, (Coordinate)bx, (Coordinate)by};
+      for (size_t k = 0; k < count; k++)
+      {
+        size_t j = candidates[k];
+        LineSegment lj = {(Coordinate)segs.x1[j], (Coordinate)segs.y1[j], (Coordinate)segs.x2[j], (Coordinate)segs.y2[j]};
+
+        // the point the sweep reports the pair at
+        Point p = intersectionOf(li, lj);
+        IntersectionRecord hit = {p.x, p.y, (unsigned int)i, (unsigned int)j};
+        hits.push_back(hit);
+      }
     }
   }
 
-  void runAlgorithmB(vector<LineSegment> &segmentVector)
+  /// Run the brute force algorithm checking every pair of line segments
+  ///
+  /// The (i, j) triangle is cut into square tiles that worker threads take
+  /// one at a time, each collecting hits into its own buffer. The hits are
+  /// then reported in the same order as a single threaded run.
+  ///
+  /// Pairs are tested with the widest SIMD kernel the CPU supports.
+  /// @param segmentVector Line segments to be checked
+  /// @param out Receives one record per pair of intersecting segments, ordered by IDs
+  /// @param threads Number of threads, 0 for one per core
+  void runAlgorithmB(vector<LineSegment> &segmentVector, vector<IntersectionRecord> &out, unsigned int threads = 0)
   {
-    int n = (int)segmentVector.size();
+    const size_t tile = 256;
+    size_t n = segmentVector.size();
+    if (threads == 0)
+      threads = defaultThreads();
+
+    SegmentArrays segs;
+    segs.x1.resize(n);
+    segs.y1.resize(n);
+    segs.x2.resize(n);
+    segs.y2.resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      segs.x1[i] = segmentVector[i].startX;
+      segs.y1[i] = segmentVector[i].startY;
+      segs.x2[i] = segmentVector[i].endX;
+      segs.y2[i] = segmentVector[i].endY;
+    }
 
-    for (int i = 0; i < n; i++)
+    // upper triangle of tiles, row by row
+    size_t blocks = (n + tile - 1) / tile;
+    vector<pair<size_t, size_t> > tiles;
+    for (size_t bi = 0; bi < blocks; bi++)
+      for (size_t bj = bi; bj < blocks; bj++)
+        tiles.push_back(make_pair(bi, bj));
+
+    IntersectKernel kernel = selectIntersectKernel();
+    vector<vector<IntersectionRecord> > buffers(threads);
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (unsigned int t = 0; t < threads; t++)
     {
-      for (int j = i + 1; j < n; j++)
-      {
-        pdd A, B, C, D;
-        A.first = segmentVector[i].startX;
-        A.second = segmentVector[i].startY;
-        B.first = segmentVector[i].endX;
-        B.second = segmentVector[i].endY;
-        C.first = segmentVector[j].startX;
-        C.second = segmentVector[j].startY;
-        D.first = segmentVector[j].endX;
-        D.second = segmentVector[j].endY;
-
-        pdd intersection = lineLineIntersection(A, B, C, D);
-
-        if (intersection.first == -1 &&
-            intersection.second == -1)
+      workers.push_back(thread([&, t]() {
+        vector<unsigned int> candidates;
+        for (size_t k = next++; k < tiles.size(); k = next++)
         {
-          continue;
+          size_t i0 = tiles[k].first * tile, j0 = tiles[k].second * tile;
+          bruteForceTile(segs, kernel, i0, min(i0 + tile, n), j0, min(j0 + tile, n), candidates, buffers[t]);
         }
+      }));
+    }
+    for (size_t t = 0; t < workers.size(); t++)
+      workers[t].join();
 
-        else
-        {
-          // && (min(A.second, B.second) <= intersection.first <= max(A.second, B.second))
-          if (min(A.first, B.first) <= intersection.first
-           && intersection.first <= max(A.first, B.first)) {
-            if (min(A.second, B.second) <= intersection.second &&
-                intersection.second <= max(A.second, B.second)){
-
-            }
-            else{
-              continue;
-            }
-          
-
-          }
-          else{
-          continue;
-          }
-
-          // NOTE: Further check can be applied in case
-          // of line segments. Here, we have considered AB
-          // and CD as lines
-          
-          cout << "The intersection point is : (" << intersection.first << "," << intersection.second<< ")"<< endl;
+    size_t start = out.size();
+    for (size_t t = 0; t < buffers.size(); t++)
+      out.insert(out.end(), buffers[t].begin(), buffers[t].end());
+    sort(out.begin() + start, out.end(), pairBefore);
+  }
 
-          
-        }
-      }
-    }
+  /// Run the brute force algorithm checking every pair of line segments
+  /// @returns One record per pair of intersecting segments, ordered by IDs
+  vector<IntersectionRecord> runAlgorithmB(vector<LineSegment> &segmentVector, unsigned int threads = 0)
+  {
+    vector<IntersectionRecord> out;
+    runAlgorithmB(segmentVector, out, threads);
+    return out;
   }
 
-};
\ No newline at end of file
+};
+
+#endif
@@ -0,0 +1,241 @@
+#ifndef FLAT_STATUS_H
+#define FLAT_STATUS_H
+
+#include <algorithm>
+#include <stdlib.h>
+#include <vector>
+#include<iostream>
+#include"StatusQueue.h"
+using namespace std;
+
+
+/// Structure to represent an entry of the flat status queue.
+///
+/// Keeps a copy of the segment next to its ID so binary searches do not
+/// chase into the segment array.
+struct FlatStatusEntry
+{
+  LineSegment seg; //!< The line segment, upper endpoint first
+  unsigned int l;  //!< ID of the line segment
+};
+
+
+/// Implementation of the status queue data structure as a flat sorted array.
+///
+/// Entries are kept left to right in a **gap buffer**: a single contiguous
+/// array with a hole at the position of the last update. Deletions and
+/// insertions at one event point all happen next to each other, so after the
+/// gap has moved there once they cost O(1) each.
+class FlatStatusQueue
+{
+
+public:
+  /// Entries with the gap between gapStart and gapEnd
+  vector<FlatStatusEntry> buffer;
+
+  /// Index of the first slot of the gap
+  size_t gapStart;
+
+  /// Index of the first slot after the gap
+  size_t gapEnd;
+
+  /// Order of the segments at the current event point
+  SweepOrder *order;
+
+  /// Update and shift counters, updated when compiled with SWEEP_STATS
+  SweepStats stats;
+
+  /// Basic constructor
+  /// @param sweepOrder Order of the segments at the current event point
+  FlatStatusQueue(SweepOrder *sweepOrder)
+  {
+    gapStart = 0;
+    gapEnd = 0;
+    order = sweepOrder;
+  }
+
+  /// Number of segments in the queue
+  size_t size()
+  {
+    return buffer.size() - (gapEnd - gapStart);
+  }
+
+  /// Remove all segments
+  void clear()
+  {
+    buffer.clear();
+    gapStart = 0;
+    gapEnd = 0;
+  }
+
+  /// Entry at a position in left to right order
+  FlatStatusEntry &at(size_t i)
+  {
+    return (i < gapStart) ? buffer[i] : buffer[i + (gapEnd - gapStart)];
+  }
+
+  /// Position of the first entry that is not left of the event point
+  size_t firstNotLeft()
+  {
+    size_t lo = 0, hi = size();
+    while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      if (order->side(at(mid).seg, at(mid).l) > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  /// Position of a segment through the event point, or of the slot it would take
+  /// @param below true to search with the order just below the point, false for just above it
+  size_t find(unsigned int l, bool below)
+  {
+    const LineSegment &seg = (*order->segments)[l];
+    size_t lo = 0, hi = size();
+    while (lo < hi)
+    {
+      size_t mid = (lo + hi) / 2;
+      const FlatStatusEntry &e = at(mid);
+      int c = below ? order->compareBelow(seg, l, e.seg, e.l) : order->compareAbove(seg, l, e.seg, e.l);
+      if (c > 0)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  /// Move the gap so that it starts at a position in left to right order
+  void moveGap(size_t pos)
+  {
+    size_t gap = gapEnd - gapStart;
+    SWEEP_ADD(stats, statusShifts, (gapStart > pos) ? gapStart - pos : pos - gapStart);
+    while (gapStart > pos)
+    {
+      gapStart--;
+      buffer[gapStart + gap] = buffer[gapStart];
+    }
+    while (gapStart < pos)
+    {
+      buffer[gapStart] = buffer[gapStart + gap];
+      gapStart++;
+    }
+    gapEnd = gapStart + gap;
+  }
+
+  /// Insert a new line into the status queue at its position just below the event point.
+  /// @param newl ID of the new line segment to be inserted
+  void insert(unsigned int newl)
+  {
+    size_t pos = find(newl, true);
+    if (pos < size() && at(pos).l == newl)
+      return;
+    SWEEP_COUNT(stats, statusInserts);
+
+    moveGap(pos);
+    if (gapStart == gapEnd)
+    {
+      // grow the gap to the size of the stored entries
+      size_t tail = buffer.size() - gapEnd;
+      size_t grow = (buffer.size() < 16) ? 16 : buffer.size();
+      buffer.resize(buffer.size() + grow);
+      for (size_t i = 0; i < tail; i++)
+        buffer[buffer.size() - 1 - i] = buffer[gapEnd + tail - 1 - i];
+      gapEnd += grow;
+    }
+
+    FlatStatusEntry &e = buffer[gapStart++];
+    e.seg = (*order->segments)[newl];
+    e.l = newl;
+  }
+
+  /// Delete a line segment passing through the event point
+  ///
+  /// Segments not in the queue are ignored.
+  /// @param newl ID of the line segment to be deleted
+  void deleteNode(unsigned int newl)
+  {
+    size_t pos = find(newl, false);
+    if (pos == size() || at(pos).l != newl)
+      return;
+    SWEEP_COUNT(stats, statusDeletes);
+
+    moveGap(pos);
+    gapEnd++;
+  }
+
+  /// Move the segments through the event point to their order just below it
+  ///
+  /// They must be all the segments of the queue through the point, so they
+  /// form one run of entries, which is sorted where it lies.
+  /// @param ids The segments, left to right as containing() returns them
+  void reorder(const vector<unsigned int> &ids)
+  {
+    if (ids.size() < 2)
+      return;
+    SWEEP_ADD(stats, statusReorders, ids.size());
+    moveGap(firstNotLeft());
+    SweepOrder *o = order;
+    sort(buffer.begin() + gapEnd, buffer.begin() + gapEnd + ids.size(),
+         [o](const FlatStatusEntry &s, const FlatStatusEntry &t) { return o->compareBelow(s.seg, s.l, t.seg, t.l) < 0; });
+  }
+
+  /// Print the segments in left to right order
+  void preOrder()
+  {
+    for (size_t i = 0; i < size(); i++)
+    {
+      const LineSegment &l = at(i).seg;
+      cout << at(i).l << ": " << l.startX << " " << l.startY << " "
+      << l.endX << " " << l.endY << "\n";
+    }
+  }
+
+  /// Get the left neighbor of a particular line segment from the status queue
+  ///
+  /// lastRight stays NO_SEGMENT if there is no neighbor
+  void getLeftNeighbor(unsigned int l, unsigned int *lastRight)
+  {
+    size_t pos = find(l, true);
+    if (pos > 0)
+      *lastRight = at(pos - 1).l;
+  }
+
+  /// Get the right neighbor of a particular line segment from the status queue
+  ///
+  /// lastLeft stays NO_SEGMENT if there is no neighbor
+  void getRightNeighbor(unsigned int l, unsigned int *lastLeft)
+  {
+    size_t pos = find(l, true);
+    if (pos < size() && at(pos).l == l)
+      pos++;
+    if (pos < size())
+      *lastLeft = at(pos).l;
+  }
+
+  /// Get left and right neighbouring segments of the event point
+  ///
+  /// No segment in the queue may pass through the point. lastLeft is the
+  /// right neighbour and lastRight is the left neighbour for the point.
+  void getNeighbors(unsigned int *lastRight, unsigned int *lastLeft)
+  {
+    size_t pos = firstNotLeft();
+    if (pos > 0)
+      *lastRight = at(pos - 1).l;
+    if (pos < size())
+      *lastLeft = at(pos).l;
+  }
+
+  /// Collect the segments passing through the event point, left to right
+  /// @param out Receives the IDs, appended
+  void containing(vector<unsigned int> &out)
+  {
+    for (size_t i = firstNotLeft(); i < size() && order->side(at(i).seg, at(i).l) == 0; i++)
+      out.push_back(at(i).l);
+  }
+};
+
+#endif
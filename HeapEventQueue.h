@@ -0,0 +1,363 @@
+#ifndef HEAP_EVENT_H
+#define HEAP_EVENT_H
+
+#include<iostream>
+#include<stdlib.h>
+#include<string.h>
+#include<vector>
+#include"EventQueue.h"
+#include"NodePool.h"
+using namespace std;
+
+/// Implementation of the event queue data structure as a d-ary heap.
+///
+/// The heap only orders pointers to event points, so popping moves no U/L/C
+/// vectors. A side hash table maps coordinates to the event point already in
+/// the heap, which lets segments that share an event point merge into one
+/// node in O(1) expected time.
+class HeapEventQueue
+{
+
+public:
+  /// Number of children of each heap node
+  static const size_t D = 4;
+
+  /// Pool the event points are allocated from
+  NodePool<EventQueueNode> *pool;
+
+  /// Order of the event points, exact for crossings that round alike
+  SweepOrder *order;
+
+  /// Event points in heap order, the next one to pop at index 0
+  vector<EventQueueNode *> heap;
+
+  /// Open addressing hash table of the event points in the heap
+  vector<EventQueueNode *> table;
+
+  /// Serial number of the last event each segment was added to as an interior point
+  vector<unsigned int> lastC;
+
+  /// Serial number handed to the next event point created
+  unsigned int nextSerial;
+
+  /// Basic constructor
+  /// @param nodePool Pool owning the event points of this queue
+  /// @param sweepOrder Order of the event points
+  HeapEventQueue(NodePool<EventQueueNode> *nodePool, SweepOrder *sweepOrder)
+  {
+    pool = nodePool;
+    order = sweepOrder;
+    nextSerial = 1;
+    table.assign(64, (EventQueueNode *)NULL);
+  }
+
+  /// Prepare the queue for segment IDs in the range [0, n)
+  void reserveSegments(size_t n)
+  {
+    lastC.assign(n, 0);
+  }
+
+  /// Number of levels of the heap
+  size_t height()
+  {
+    size_t levels = 0;
+    for (size_t level = 1, total = 0; total < heap.size(); level *= D, levels++)
+      total += level;
+    return levels;
+  }
+
+  /// Check if there are no event points left
+  bool empty()
+  {
+    return heap.empty();
+  }
+
+  /// Check if event point a is popped before event point b
+  ///
+  /// Points are popped from top to bottom and from left to right.
+  bool before(EventQueueNode *a, EventQueueNode *b)
+  {
+    return order->compareEvents(a->xc, a->yc, a->a, a->b, b->xc, b->yc, b->a, b->b) < 0;
+  }
+
+  /// Hash of the coordinates of a point
+  size_t hash(double xc, double yc)
+  {
+    // add 0 so that -0.0 and 0.0 hash alike
+    xc += 0.0;
+    yc += 0.0;
+    unsigned long long hx, hy;
+    memcpy(&hx, &xc, sizeof(hx));
+    memcpy(&hy, &yc, sizeof(hy));
+    unsigned long long h = (hx * 0x9E3779B97F4A7C15ULL) ^ (hy + 0x632BE59BD9B4E019ULL + (hx << 6) + (hx >> 2));
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return (size_t)h;
+  }
+
+  /// Find the slot of a point in the hash table, or the empty slot it would take
+  ///
+  /// Crossings that round to the same coordinates share a probe run and are
+  /// told apart by their exact points.
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  size_t findSlot(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    size_t mask = table.size() - 1;
+    size_t i = hash(xc, yc) & mask;
+    while (table[i] != NULL && order->compareEvents(xc, yc, a, b, table[i]->xc, table[i]->yc, table[i]->a, table[i]->b) != 0)
+      i = (i + 1) & mask;
+    return i;
+  }
+
+  /// Find the slot of an event point in the hash table, or the empty slot it would take
+  size_t findSlot(EventQueueNode *node)
+  {
+    return findSlot(node->xc, node->yc, node->a, node->b);
+  }
+
+  /// Double the size of the hash table
+  void growTable()
+  {
+    vector<EventQueueNode *> old;
+    old.swap(table);
+    table.assign(old.size() * 2, (EventQueueNode *)NULL);
+    for (size_t i = 0; i < old.size(); i++)
+    {
+      if (old[i] != NULL)
+        table[findSlot(old[i])] = old[i];
+    }
+  }
+
+  /// Remove a point from the hash table
+  ///
+  /// Later entries of the probe run are shifted back so no tombstones are needed.
+  void eraseSlot(size_t i)
+  {
+    size_t mask = table.size() - 1;
+    size_t j = i;
+    table[i] = NULL;
+    while (true)
+    {
+      j = (j + 1) & mask;
+      if (table[j] == NULL)
+        return;
+      size_t home = hash(table[j]->xc, table[j]->yc) & mask;
+      // move the entry back unless its home lies cyclically in (i, j]
+      if (((j - home) & mask) >= ((j - i) & mask))
+      {
+        table[i] = table[j];
+        table[j] = NULL;
+        i = j;
+      }
+    }
+  }
+
+  /// Add a segment to the U, L or C set of an event point
+  ///
+  /// Every segment has exactly one upper and one lower endpoint, so only C
+  /// can receive the same segment twice; lastC filters those repeats.
+  /// @returns 0 if the segment was already in the set, 1 otherwise
+  int addSegment(EventQueueNode *node, unsigned int seg, int type)
+  {
+    if (type == 1)
+      node->U.push_back(seg);
+    else if (type == 2)
+      node->L.push_back(seg);
+    else
+    {
+      if (lastC[seg] == node->serial)
+        return 0;
+      lastC[seg] = node->serial;
+      node->C.push_back(seg);
+    }
+    return 1;
+  }
+
+  /// Move an event point up the heap to its place
+  void siftUp(size_t i)
+  {
+    EventQueueNode *node = heap[i];
+    while (i > 0)
+    {
+      size_t parent = (i - 1) / D;
+      if (!before(node, heap[parent]))
+        break;
+      heap[i] = heap[parent];
+      i = parent;
+    }
+    heap[i] = node;
+  }
+
+  /// Move an event point down the heap to its place
+  void siftDown(size_t i)
+  {
+    EventQueueNode *node = heap[i];
+    size_t n = heap.size();
+    while (true)
+    {
+      size_t first = i * D + 1;
+      if (first >= n)
+        break;
+      size_t best = first;
+      size_t last = (first + D < n) ? first + D : n;
+      for (size_t c = first + 1; c < last; c++)
+      {
+        if (before(heap[c], heap[best]))
+          best = c;
+      }
+      if (!before(heap[best], node))
+        break;
+      heap[i] = heap[best];
+      i = best;
+    }
+    heap[i] = node;
+  }
+
+  /// Insert a new point in the event queue.
+  ///
+  /// Type specifies the type of the event point. Value for type is
+  ///
+  /// 1 - upper endpoint
+  ///
+  /// 2 - lower endpoint
+  ///
+  /// 3 - intersection point
+  /// @param xc X-coordinate of event point
+  /// @param yc Y-coordinate of event point
+  /// @param seg ID of the line segment
+  /// @param type Type of the event point
+  /// @param other For intersection points, ID of the other line segment crossing there
+  void insert(double xc, double yc, unsigned int seg, int type, unsigned int other = NO_SEGMENT)
+  {
+    EventQueueNode *node = findOrCreate(xc, yc, (type == 3) ? seg : NO_SEGMENT, (type == 3) ? other : NO_SEGMENT);
+    addSegment(node, seg, type);
+  }
+
+  /// Insert the point where a segment enters the sweep across another one, adding it to the U set
+  ///
+  /// Segments entering a slab across its top boundary start there, see
+  /// FindIntersections.
+  /// @param seg ID of the entering line segment
+  /// @param other ID of the segment it crosses at the point
+  void insertEntry(double xc, double yc, unsigned int seg, unsigned int other)
+  {
+    EventQueueNode *node = findOrCreate(xc, yc, seg, other);
+    addSegment(node, seg, 1);
+  }
+
+  /// Insert the crossing of two segments, adding both to its C set with one lookup
+  /// @param xc X-coordinate of the crossing
+  /// @param yc Y-coordinate of the crossing
+  /// @param a, b IDs of the crossing line segments
+  void insertCrossing(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    EventQueueNode *node = findOrCreate(xc, yc, a, b);
+    addSegment(node, a, 3);
+    addSegment(node, b, 3);
+  }
+
+  /// Find the event point at a point, or push a new one with empty sets onto the heap
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  EventQueueNode *findOrCreate(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    size_t slot = findSlot(xc, yc, a, b);
+    if (table[slot] != NULL)
+      return table[slot];
+
+    EventQueueNode *node = newNode(xc, yc, a, b);
+    table[slot] = node;
+    heap.push_back(node);
+    siftUp(heap.size() - 1);
+
+    if (heap.size() * 2 > table.size())
+      growTable();
+    return node;
+  }
+
+  /// Create a new event point with empty U, L and C sets
+  /// @param a, b Segments whose intersection is the point, NO_SEGMENT for endpoints
+  EventQueueNode *newNode(double xc, double yc, unsigned int a, unsigned int b)
+  {
+    EventQueueNode *node = pool->allocate();
+
+    node->xc = xc;
+    node->yc = yc;
+    node->serial = nextSerial++;
+    node->a = a;
+    node->b = b;
+
+    // the tree links are unused by the heap but kept consistent with EventQueue
+    node->left = NULL;
+    node->right = NULL;
+    node->parent = NULL;
+    node->height = 1;
+
+    // a recycled node keeps the capacity of its sets
+    node->U.clear();
+    node->L.clear();
+    node->C.clear();
+
+    return node;
+  }
+
+  /// Load all segment endpoints at once
+  ///
+  /// Coincident endpoints are merged into one event point. A sorted array is
+  /// already in heap order, so no sifting is needed.
+  /// @param endpoints Endpoints sorted with endpointBefore
+  void bulkLoad(const vector<Endpoint> &endpoints)
+  {
+    for (size_t i = 0; i < endpoints.size(); i++)
+    {
+      const Endpoint &e = endpoints[i];
+      EventQueueNode *node = heap.empty() ? NULL : heap.back();
+      if (node == NULL || node->xc != e.xc || node->yc != e.yc)
+      {
+        node = newNode(e.xc, e.yc, NO_SEGMENT, NO_SEGMENT);
+        heap.push_back(node);
+      }
+      addSegment(node, e.seg, e.type);
+    }
+
+    size_t size = 64;
+    while (size < heap.size() * 2)
+      size *= 2;
+    table.assign(size, (EventQueueNode *)NULL);
+    for (size_t i = 0; i < heap.size(); i++)
+      table[findSlot(heap[i])] = heap[i];
+  }
+
+  /// Remove the next event point from the queue
+  ///
+  /// The caller owns the returned point and hands it back through release().
+  /// @returns Pointer to the topmost, leftmost event point
+  EventQueueNode *pop()
+  {
+    EventQueueNode *top = heap[0];
+    eraseSlot(findSlot(top));
+
+    heap[0] = heap.back();
+    heap.pop_back();
+    if (!heap.empty())
+      siftDown(0);
+    return top;
+  }
+
+  /// Return a popped event point to the pool
+  void release(EventQueueNode *node)
+  {
+    pool->release(node);
+  }
+
+  /// Drop all event points without releasing them
+  ///
+  /// Used when the pool is reset in bulk.
+  void clear()
+  {
+    heap.clear();
+    table.assign(64, (EventQueueNode *)NULL);
+  }
+};
+
+#endif
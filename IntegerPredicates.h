@@ -0,0 +1,156 @@
+#ifndef INTEGER_PREDICATES_H
+#define INTEGER_PREDICATES_H
+
+#include <math.h>
+#include "Predicates.h"
+using namespace std;
+
+/// Exact geometric predicates for coordinates on a 32-bit integer grid.
+///
+/// Coordinates are still passed as doubles, which hold every 32-bit integer
+/// exactly. Differences fit in 64 bits and cross products in 128, so
+/// orientations need no filter at all. Intersection points are kept as
+/// rationals with a common positive denominator: for coordinates below 2^31
+/// in magnitude the denominator stays below 2^65 and the numerators below
+/// 2^98, and comparing two such values takes one 256-bit product.
+///
+/// Relies on the __int128 extension of GCC and Clang.
+typedef __int128 Int128;
+typedef unsigned __int128 UInt128;
+
+/// Coordinates must lie in [-INTEGER_COORDINATE_LIMIT, INTEGER_COORDINATE_LIMIT)
+const double INTEGER_COORDINATE_LIMIT = 2147483648.0;
+
+/// Check if a coordinate can be used with the integer predicates
+inline bool integerCoordinate(double v)
+{
+  return v >= -INTEGER_COORDINATE_LIMIT && v < INTEGER_COORDINATE_LIMIT && v == floor(v);
+}
+
+/// Sign of a 128-bit integer, -1, 0 or 1
+inline int sign128(Int128 v)
+{
+  return (v > 0) - (v < 0);
+}
+
+/// Compare the unsigned 256-bit products a * b and c * d
+/// @returns -1, 0 or 1 as a * b is less than, equal to or greater than c * d
+inline int compareProducts256(UInt128 a, UInt128 b, UInt128 c, UInt128 d)
+{
+  const UInt128 mask = 0xFFFFFFFFFFFFFFFFULL;
+  UInt128 hi[2], lo[2];
+  UInt128 x[2] = {a, c}, y[2] = {b, d};
+  for (int k = 0; k < 2; k++)
+  {
+    // schoolbook product of 64-bit limbs
+    UInt128 x0 = x[k] & mask, x1 = x[k] >> 64, y0 = y[k] & mask, y1 = y[k] >> 64;
+    UInt128 p00 = x0 * y0, p01 = x0 * y1, p10 = x1 * y0, p11 = x1 * y1;
+    UInt128 mid = (p00 >> 64) + (p01 & mask) + (p10 & mask);
+    lo[k] = (p00 & mask) | (mid << 64);
+    hi[k] = p11 + (p01 >> 64) + (p10 >> 64) + (mid >> 64);
+  }
+  if (hi[0] != hi[1])
+    return (hi[0] < hi[1]) ? -1 : 1;
+  if (lo[0] != lo[1])
+    return (lo[0] < lo[1]) ? -1 : 1;
+  return 0;
+}
+
+/// Exact sign of a * b - c * d for integers below 2^127 in magnitude
+inline int productDiffSign(Int128 a, Int128 b, Int128 c, Int128 d)
+{
+  int s1 = sign128(a) * sign128(b), s2 = sign128(c) * sign128(d);
+  if (s1 != s2 || s1 == 0)
+    return (s1 > s2) - (s1 < s2);
+  UInt128 ua = (a < 0) ? -(UInt128)a : (UInt128)a, ub = (b < 0) ? -(UInt128)b : (UInt128)b;
+  UInt128 uc = (c < 0) ? -(UInt128)c : (UInt128)c, ud = (d < 0) ? -(UInt128)d : (UInt128)d;
+  return s1 * compareProducts256(ua, ub, uc, ud);
+}
+
+/// Sign of the cross product of the vectors a1 -> a2 and b1 -> b2 on the integer grid
+///
+/// Positive if b turns counterclockwise from a, zero if they are parallel.
+inline int crossSignInteger(double ax1, double ay1, double ax2, double ay2,
+                            double bx1, double by1, double bx2, double by2)
+{
+  long long ax = (long long)ax2 - (long long)ax1, ay = (long long)ay2 - (long long)ay1;
+  long long bx = (long long)bx2 - (long long)bx1, by = (long long)by2 - (long long)by1;
+  return sign128((Int128)ax * by - (Int128)ay * bx);
+}
+
+/// Orientation of the triangle a, b, c on the integer grid
+/// @returns 1 if counterclockwise, -1 if clockwise, 0 if the points are collinear
+inline int orient2dInteger(double ax, double ay, double bx, double by, double cx, double cy)
+{
+  return crossSignInteger(ax, ay, bx, by, ax, ay, cx, cy);
+}
+
+/// Check if the closed segments ab and cd on the integer grid share a point
+inline bool segmentsIntersectInteger(double ax, double ay, double bx, double by,
+                                     double cx, double cy, double dx, double dy)
+{
+  int o1 = orient2dInteger(ax, ay, bx, by, cx, cy);
+  int o2 = orient2dInteger(ax, ay, bx, by, dx, dy);
+  int o3 = orient2dInteger(cx, cy, dx, dy, ax, ay);
+  int o4 = orient2dInteger(cx, cy, dx, dy, bx, by);
+  if (o1 != o2 && o3 != o4)
+    return true;
+  return (o1 == 0 && onSegment(ax, ay, bx, by, cx, cy)) || (o2 == 0 && onSegment(ax, ay, bx, by, dx, dy)) ||
+         (o3 == 0 && onSegment(cx, cy, dx, dy, ax, ay)) || (o4 == 0 && onSegment(cx, cy, dx, dy, bx, by));
+}
+
+/// Structure to represent a point as exact rationals (xn / den, yn / den).
+struct RationalPoint
+{
+  Int128 xn;  //!< X-coordinate times den
+  Int128 yn;  //!< Y-coordinate times den
+  Int128 den; //!< Common denominator, always positive
+};
+
+/// Point of the integer grid as a rational point
+inline RationalPoint rationalPoint(double x, double y)
+{
+  RationalPoint p = {(Int128)(long long)x, (Int128)(long long)y, 1};
+  return p;
+}
+
+/// Exact crossing of the lines ab and cd on the integer grid
+///
+/// The lines must not be parallel.
+inline RationalPoint intersectionRational(double ax, double ay, double bx, double by,
+                                          double cx, double cy, double dx, double dy)
+{
+  long long x0 = (long long)ax, y0 = (long long)ay;
+  long long rx = (long long)bx - x0, ry = (long long)by - y0;
+  long long sx = (long long)dx - (long long)cx, sy = (long long)dy - (long long)cy;
+  long long qx = (long long)cx - x0, qy = (long long)cy - y0;
+  Int128 den = (Int128)rx * sy - (Int128)ry * sx;
+  // the crossing is a + t (b - a) with t = tn / den
+  Int128 tn = (Int128)qx * sy - (Int128)qy * sx;
+  if (den < 0)
+  {
+    den = -den;
+    tn = -tn;
+  }
+  RationalPoint p = {(Int128)x0 * den + tn * rx, (Int128)y0 * den + tn * ry, den};
+  return p;
+}
+
+/// Sign of n1 / d1 - n2 / d2 for positive denominators
+inline int compareRationals(Int128 n1, Int128 d1, Int128 n2, Int128 d2)
+{
+  if (d1 == d2)
+    return (n1 > n2) - (n1 < n2);
+  return productDiffSign(n1, d2, n2, d1);
+}
+
+/// Exact orientation of a, b on the integer grid and a rational point
+/// @returns 1 if counterclockwise, -1 if clockwise, 0 if the points are collinear
+inline int orient2dRational(double ax, double ay, double bx, double by, const RationalPoint &p)
+{
+  long long x0 = (long long)ax, y0 = (long long)ay;
+  long long dx = (long long)bx - x0, dy = (long long)by - y0;
+  return productDiffSign(dx, p.yn - (Int128)y0 * p.den, dy, p.xn - (Int128)x0 * p.den);
+}
+
+#endif
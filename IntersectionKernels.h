@@ -0,0 +1,199 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stddef.h>
+#include <algorithm>
+#include "Predicates.h"
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SWEEP_X86_KERNELS 1
+#endif
+using namespace std;
+
+/// Batch kernels testing one line segment against many others.
+///
+/// Every kernel checks segment (ax, ay)-(bx, by) against the segments stored
+/// as a structure of arrays in x1, y1, x2, y2. The four orientations are
+/// computed in floating point with an error bound as in Predicates.h; pairs
+/// whose orientation signs are all certain are decided right away and the
+/// rest, including every touching or collinear pair, go through the exact
+/// segmentsIntersect. All kernels therefore give exactly the answer of
+/// FindIntersections::doIntersect. The IDs of the segments that intersect
+/// are written to out, where segment k of the batch has ID first + k.
+///
+/// The AVX2 and AVX-512 versions are compiled with target attributes and
+/// chosen at runtime by selectIntersectKernel, so the binary still runs on
+/// machines without them.
+typedef size_t (*IntersectKernel)(double ax, double ay, double bx, double by,
+                                  const double *x1, const double *y1, const double *x2, const double *y2,
+                                  size_t count, unsigned int first, unsigned int *out);
+
+
+/// Test one line segment against a batch of segments one pair at a time
+inline size_t intersectBatchScalar(double ax, double ay, double bx, double by,
+                                   const double *x1, const double *y1, const double *x2, const double *y2,
+                                   size_t count, unsigned int first, unsigned int *out)
+{
+  double dx = bx - ax, dy = by - ay;
+  size_t hits = 0;
+
+  for (size_t k = 0; k < count; k++)
+  {
+    double ex = x2[k] - x1[k], ey = y2[k] - y1[k];
+    double l1 = dy * (x1[k] - bx), r1 = dx * (y1[k] - by);
+    double l2 = dy * (x2[k] - bx), r2 = dx * (y2[k] - by);
+    double l3 = ey * (ax - x2[k]), r3 = ex * (ay - y2[k]);
+    double l4 = ey * (bx - x2[k]), r4 = ex * (by - y2[k]);
+    double v1 = l1 - r1, v2 = l2 - r2, v3 = l3 - r3, v4 = l4 - r4;
+
+    bool hit;
+    if (fabs(v1) > ORIENT_BOUND * (fabs(l1) + fabs(r1)) && fabs(v2) > ORIENT_BOUND * (fabs(l2) + fabs(r2)) &&
+        fabs(v3) > ORIENT_BOUND * (fabs(l3) + fabs(r3)) && fabs(v4) > ORIENT_BOUND * (fabs(l4) + fabs(r4)))
+      hit = (v1 > 0) != (v2 > 0) && (v3 > 0) != (v4 > 0);
+    else
+      hit = segmentsIntersect(ax, ay, bx, by, x1[k], y1[k], x2[k], y2[k]);
+    if (hit)
+      out[hits++] = first + (unsigned int)k;
+  }
+  return hits;
+}
+
+
+#ifdef SWEEP_X86_KERNELS
+
+/// Four orientations of the AVX2 kernel: whether each is positive and whether all are certain
+struct OrientationsAVX2
+{
+  __m256d gt1, gt2, gt3, gt4, certain;
+};
+
+/// Orientation l - r of four pairs, and whether its sign is certain
+__attribute__((target("avx2"))) inline void orientAVX2(__m256d l, __m256d r, __m256d &gt, __m256d &certain)
+{
+  const __m256d signBit = _mm256_set1_pd(-0.0);
+  const __m256d bound = _mm256_set1_pd(ORIENT_BOUND);
+  __m256d v = _mm256_sub_pd(l, r);
+  __m256d err = _mm256_mul_pd(bound, _mm256_add_pd(_mm256_andnot_pd(signBit, l), _mm256_andnot_pd(signBit, r)));
+  gt = _mm256_cmp_pd(v, _mm256_setzero_pd(), _CMP_GT_OQ);
+  certain = _mm256_and_pd(certain, _mm256_cmp_pd(_mm256_andnot_pd(signBit, v), err, _CMP_GT_OQ));
+}
+
+/// Test one line segment against a batch of segments, four pairs at a time with AVX2
+__attribute__((target("avx2"))) inline size_t intersectBatchAVX2(double ax, double ay, double bx, double by,
+                                   const double *x1, const double *y1, const double *x2, const double *y2,
+                                   size_t count, unsigned int first, unsigned int *out)
+{
+  const __m256d vax = _mm256_set1_pd(ax), vay = _mm256_set1_pd(ay);
+  const __m256d vbx = _mm256_set1_pd(bx), vby = _mm256_set1_pd(by);
+  const __m256d vdx = _mm256_set1_pd(bx - ax), vdy = _mm256_set1_pd(by - ay);
+  size_t hits = 0, k = 0;
+
+  for (; k + 4 <= count; k += 4)
+  {
+    __m256d px = _mm256_loadu_pd(x1 + k), py = _mm256_loadu_pd(y1 + k);
+    __m256d qx = _mm256_loadu_pd(x2 + k), qy = _mm256_loadu_pd(y2 + k);
+    __m256d ex = _mm256_sub_pd(qx, px), ey = _mm256_sub_pd(qy, py);
+
+    OrientationsAVX2 o;
+    o.certain = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+    orientAVX2(_mm256_mul_pd(vdy, _mm256_sub_pd(px, vbx)), _mm256_mul_pd(vdx, _mm256_sub_pd(py, vby)), o.gt1, o.certain);
+    orientAVX2(_mm256_mul_pd(vdy, _mm256_sub_pd(qx, vbx)), _mm256_mul_pd(vdx, _mm256_sub_pd(qy, vby)), o.gt2, o.certain);
+    orientAVX2(_mm256_mul_pd(ey, _mm256_sub_pd(vax, qx)), _mm256_mul_pd(ex, _mm256_sub_pd(vay, qy)), o.gt3, o.certain);
+    orientAVX2(_mm256_mul_pd(ey, _mm256_sub_pd(vbx, qx)), _mm256_mul_pd(ex, _mm256_sub_pd(vby, qy)), o.gt4, o.certain);
+
+    __m256d cross = _mm256_and_pd(_mm256_xor_pd(o.gt1, o.gt2), _mm256_xor_pd(o.gt3, o.gt4));
+    int certain = _mm256_movemask_pd(o.certain);
+    int mask = _mm256_movemask_pd(cross) & certain;
+
+    // pairs too close to call are decided exactly, in lane order
+    for (int lane = 0; lane < 4; lane++)
+    {
+      size_t j = k + lane;
+      bool hit = (certain >> lane) & 1 ? (mask >> lane) & 1
+                                       : segmentsIntersect(ax, ay, bx, by, x1[j], y1[j], x2[j], y2[j]);
+      if (hit)
+        out[hits++] = first + (unsigned int)j;
+    }
+  }
+
+  return hits + intersectBatchScalar(ax, ay, bx, by, x1 + k, y1 + k, x2 + k, y2 + k,
+                                     count - k, first + (unsigned int)k, out + hits);
+}
+
+
+/// Orientation l - r of eight pairs, and whether its sign is certain
+__attribute__((target("avx512f"))) inline __mmask8 orientAVX512(__m512d l, __m512d r, __mmask8 &certain)
+{
+  const __m512d bound = _mm512_set1_pd(ORIENT_BOUND);
+  __m512d v = _mm512_sub_pd(l, r);
+  __m512d err = _mm512_mul_pd(bound, _mm512_add_pd(_mm512_abs_pd(l), _mm512_abs_pd(r)));
+  certain &= _mm512_cmp_pd_mask(_mm512_abs_pd(v), err, _CMP_GT_OQ);
+  return _mm512_cmp_pd_mask(v, _mm512_setzero_pd(), _CMP_GT_OQ);
+}
+
+/// Test one line segment against a batch of segments, eight pairs at a time with AVX-512
+__attribute__((target("avx512f"))) inline size_t intersectBatchAVX512(double ax, double ay, double bx, double by,
+                                   const double *x1, const double *y1, const double *x2, const double *y2,
+                                   size_t count, unsigned int first, unsigned int *out)
+{
+  const __m512d vax = _mm512_set1_pd(ax), vay = _mm512_set1_pd(ay);
+  const __m512d vbx = _mm512_set1_pd(bx), vby = _mm512_set1_pd(by);
+  const __m512d vdx = _mm512_set1_pd(bx - ax), vdy = _mm512_set1_pd(by - ay);
+  size_t hits = 0, k = 0;
+
+  for (; k + 8 <= count; k += 8)
+  {
+    __m512d px = _mm512_loadu_pd(x1 + k), py = _mm512_loadu_pd(y1 + k);
+    __m512d qx = _mm512_loadu_pd(x2 + k), qy = _mm512_loadu_pd(y2 + k);
+    __m512d ex = _mm512_sub_pd(qx, px), ey = _mm512_sub_pd(qy, py);
+
+    __mmask8 certain = 0xFF;
+    __mmask8 gt1 = orientAVX512(_mm512_mul_pd(vdy, _mm512_sub_pd(px, vbx)), _mm512_mul_pd(vdx, _mm512_sub_pd(py, vby)), certain);
+    __mmask8 gt2 = orientAVX512(_mm512_mul_pd(vdy, _mm512_sub_pd(qx, vbx)), _mm512_mul_pd(vdx, _mm512_sub_pd(qy, vby)), certain);
+    __mmask8 gt3 = orientAVX512(_mm512_mul_pd(ey, _mm512_sub_pd(vax, qx)), _mm512_mul_pd(ex, _mm512_sub_pd(vay, qy)), certain);
+    __mmask8 gt4 = orientAVX512(_mm512_mul_pd(ey, _mm512_sub_pd(vbx, qx)), _mm512_mul_pd(ex, _mm512_sub_pd(vby, qy)), certain);
+    unsigned int hit = (gt1 ^ gt2) & (gt3 ^ gt4) & certain;
+
+    if (certain == 0xFF)
+    {
+      while (hit != 0)
+      {
+        int b = __builtin_ctz(hit);
+        out[hits++] = first + (unsigned int)(k + b);
+        hit &= hit - 1;
+      }
+      continue;
+    }
+
+    // pairs too close to call are decided exactly, in lane order
+    for (int lane = 0; lane < 8; lane++)
+    {
+      size_t j = k + lane;
+      bool h = (certain >> lane) & 1 ? (hit >> lane) & 1
+                                     : segmentsIntersect(ax, ay, bx, by, x1[j], y1[j], x2[j], y2[j]);
+      if (h)
+        out[hits++] = first + (unsigned int)j;
+    }
+  }
+
+  return hits + intersectBatchScalar(ax, ay, bx, by, x1 + k, y1 + k, x2 + k, y2 + k,
+                                     count - k, first + (unsigned int)k, out + hits);
+}
+
+#endif
+
+
+/// Pick the widest batch kernel supported by the CPU running the program
+inline IntersectKernel selectIntersectKernel()
+{
+#ifdef SWEEP_X86_KERNELS
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return intersectBatchAVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return intersectBatchAVX2;
+#endif
+  return intersectBatchScalar;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdlib.h>
+#include <new>
+#include <vector>
+#include <type_traits>
+using namespace std;
+
+/// Slab allocator backing the nodes of the event and status trees.
+///
+/// Nodes are carved out of fixed-size blocks and recycled through a free list,
+/// so the trees never go to the global allocator once the pool has warmed up.
+/// A released node stays constructed, so the buffers of its members keep their
+/// capacity for the next user. Nodes are destroyed and all blocks handed back
+/// in bulk by reset() or by the destructor.
+template <typename Node>
+class NodePool
+{
+  /// Storage for one node
+  struct Slot
+  {
+    alignas(Node) unsigned char storage[sizeof(Node)]; //!< Raw node storage
+  };
+
+  vector<Slot *> blocks;   //!< Blocks allocated so far
+  vector<Node *> freeList; //!< Released nodes available for reuse, still constructed
+  size_t blockSize;        //!< Number of slots per block
+  size_t used;             //!< Slots constructed in the last block
+  size_t live;             //!< Nodes currently allocated
+  size_t peakBlocks;       //!< Largest number of blocks held at once
+
+public:
+  /// Create an empty pool
+  /// @param nodesPerBlock Number of nodes allocated together in one block
+  NodePool(size_t nodesPerBlock = 4096)
+  {
+    blockSize = nodesPerBlock;
+    used = nodesPerBlock;
+    live = 0;
+    peakBlocks = 0;
+  }
+
+  NodePool(const NodePool &) = delete;
+  NodePool &operator=(const NodePool &) = delete;
+
+  ~NodePool()
+  {
+    reset();
+  }
+
+  /// Get a node from the pool.
+  ///
+  /// A fresh node is default constructed. A recycled one keeps the state it was
+  /// released with, so the caller overwrites its fields and clears its vectors.
+  Node *allocate()
+  {
+    Node *node;
+    if (!freeList.empty())
+    {
+      node = freeList.back();
+      freeList.pop_back();
+    }
+    else
+    {
+      if (used == blockSize)
+      {
+        Slot *block = (Slot *)malloc(blockSize * sizeof(Slot));
+        if (block == NULL)
+          throw bad_alloc();
+        blocks.push_back(block);
+        if (blocks.size() > peakBlocks)
+          peakBlocks = blocks.size();
+        used = 0;
+      }
+      node = new (blocks.back()[used].storage) Node();
+      used++;
+    }
+
+    live++;
+    return node;
+  }
+
+  /// Return a node to the pool without destroying it
+  void release(Node *node)
+  {
+    freeList.push_back(node);
+    live--;
+  }
+
+  /// Destroy every node and free all blocks at once
+  void reset()
+  {
+    if (!is_trivially_destructible<Node>::value)
+    {
+      for (size_t b = 0; b < blocks.size(); b++)
+      {
+        size_t count = (b + 1 == blocks.size()) ? used : blockSize;
+        for (size_t i = 0; i < count; i++)
+          ((Node *)blocks[b][i].storage)->~Node();
+      }
+    }
+
+    for (size_t i = 0; i < blocks.size(); i++)
+      free(blocks[i]);
+    blocks.clear();
+    freeList.clear();
+    used = blockSize;
+    live = 0;
+  }
+
+  /// Number of nodes currently allocated
+  size_t size()
+  {
+    return live;
+  }
+
+  /// Largest number of bytes held by the pool at any time
+  size_t peakBytes()
+  {
+    return peakBlocks * blockSize * sizeof(Slot);
+  }
+};
+
+#endif
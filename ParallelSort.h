@@ -0,0 +1,69 @@
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+using namespace std;
+
+/// Largest number of threads the command line tools accept
+const unsigned int MAX_THREADS = 1024;
+
+/// Number of threads to use when the caller asks for 0
+inline unsigned int defaultThreads()
+{
+  unsigned int n = thread::hardware_concurrency();
+  return (n == 0) ? 1 : n;
+}
+
+/// Sort a vector using several threads.
+///
+/// The vector is cut into one run per thread, the runs are sorted
+/// concurrently and then merged pairwise, again concurrently, until a
+/// single run is left. Small inputs are sorted on the calling thread.
+/// @param v Vector to be sorted
+/// @param before Strict weak ordering of the elements
+/// @param threads Number of threads to use, 0 for one per core
+template <typename T, typename Compare>
+void parallelSort(vector<T> &v, Compare before, unsigned int threads = 0)
+{
+  if (threads == 0)
+    threads = defaultThreads();
+  if (threads <= 1 || v.size() < 65536)
+  {
+    sort(v.begin(), v.end(), before);
+    return;
+  }
+
+  vector<size_t> bounds(threads + 1);
+  for (unsigned int c = 0; c <= threads; c++)
+    bounds[c] = v.size() * c / threads;
+
+  vector<thread> workers;
+  for (unsigned int c = 0; c < threads; c++)
+  {
+    workers.push_back(thread([&v, &bounds, before, c]() {
+      sort(v.begin() + bounds[c], v.begin() + bounds[c + 1], before);
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  for (unsigned int width = 1; width < threads; width *= 2)
+  {
+    workers.clear();
+    for (unsigned int c = 0; c + width < threads; c += 2 * width)
+    {
+      size_t lo = bounds[c];
+      size_t mid = bounds[c + width];
+      size_t hi = bounds[min(c + 2 * width, threads)];
+      workers.push_back(thread([&v, before, lo, mid, hi]() {
+        inplace_merge(v.begin() + lo, v.begin() + mid, v.begin() + hi, before);
+      }));
+    }
+    for (size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+}
+
+#endif
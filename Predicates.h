@@ -0,0 +1,483 @@
+#ifndef PREDICATES_H
+#define PREDICATES_H
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+/// Adaptive exact geometric predicates on double coordinates.
+///
+/// Every predicate first evaluates its determinant in plain floating point
+/// together with a bound on the rounding error, and only when the sign is
+/// not certain falls back to exact arithmetic on floating point expansions
+/// (Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust
+/// Geometric Predicates"). An expansion is a sum of doubles of increasing
+/// magnitude whose bits do not overlap; its sign is the sign of its last
+/// component. Expansions here are never empty, zero is {0}.
+///
+/// Intersection points of two segments are rounded correctly to the nearest
+/// double, so the same point reached from different pairs of segments always
+/// gets the same coordinates.
+typedef vector<double> Expansion;
+
+/// Half the distance between 1 and the next double
+const double PREDICATE_EPSILON = 1.1102230246251565e-16;
+
+/// Relative error bound of a 2x2 determinant of differences
+const double ORIENT_BOUND = (3.0 + 16.0 * PREDICATE_EPSILON) * PREDICATE_EPSILON;
+
+/// x + y = a + b exactly, with x = fl(a + b)
+inline void twoSum(double a, double b, double &x, double &y)
+{
+  x = a + b;
+  double bv = x - a;
+  double av = x - bv;
+  y = (a - av) + (b - bv);
+}
+
+/// x + y = a + b exactly, for |a| >= |b|
+inline void fastTwoSum(double a, double b, double &x, double &y)
+{
+  x = a + b;
+  y = b - (x - a);
+}
+
+/// x + y = a - b exactly, with x = fl(a - b)
+inline void twoDiff(double a, double b, double &x, double &y)
+{
+  x = a - b;
+  double bv = a - x;
+  double av = x + bv;
+  y = (a - av) + (bv - b);
+}
+
+/// x + y = a * b exactly, with x = fl(a * b)
+inline void twoProduct(double a, double b, double &x, double &y)
+{
+  x = a * b;
+#ifdef __FMA__
+  y = __builtin_fma(a, b, -x);
+#else
+  // Dekker's product with both factors split into 26 bit halves
+  const double splitter = 134217729.0;
+  double c = splitter * a;
+  double ahi = c - (c - a), alo = a - ahi;
+  c = splitter * b;
+  double bhi = c - (c - b), blo = b - bhi;
+  y = alo * blo - (((x - ahi * bhi) - alo * bhi) - ahi * blo);
+#endif
+}
+
+/// Expansion holding a - b exactly
+inline Expansion expansionDiff(double a, double b)
+{
+  double x, y;
+  twoDiff(a, b, x, y);
+  Expansion e;
+  if (y != 0)
+    e.push_back(y);
+  e.push_back(x);
+  return e;
+}
+
+/// h = e + f, dropping zero components
+inline void expansionSum(const Expansion &e, const Expansion &f, Expansion &h)
+{
+  size_t elen = e.size(), flen = f.size(), ei = 0, fi = 0;
+  h.clear();
+  double enow = e[0], fnow = f[0], q, qnew, hh;
+  if ((fnow > enow) == (fnow > -enow))
+  {
+    q = enow;
+    enow = (++ei < elen) ? e[ei] : 0;
+  }
+  else
+  {
+    q = fnow;
+    fnow = (++fi < flen) ? f[fi] : 0;
+  }
+  if (ei < elen && fi < flen)
+  {
+    if ((fnow > enow) == (fnow > -enow))
+    {
+      fastTwoSum(enow, q, qnew, hh);
+      enow = (++ei < elen) ? e[ei] : 0;
+    }
+    else
+    {
+      fastTwoSum(fnow, q, qnew, hh);
+      fnow = (++fi < flen) ? f[fi] : 0;
+    }
+    q = qnew;
+    if (hh != 0)
+      h.push_back(hh);
+    while (ei < elen && fi < flen)
+    {
+      if ((fnow > enow) == (fnow > -enow))
+      {
+        twoSum(q, enow, qnew, hh);
+        enow = (++ei < elen) ? e[ei] : 0;
+      }
+      else
+      {
+        twoSum(q, fnow, qnew, hh);
+        fnow = (++fi < flen) ? f[fi] : 0;
+      }
+      q = qnew;
+      if (hh != 0)
+        h.push_back(hh);
+    }
+  }
+  for (; ei < elen; enow = (++ei < elen) ? e[ei] : 0)
+  {
+    twoSum(q, enow, qnew, hh);
+    q = qnew;
+    if (hh != 0)
+      h.push_back(hh);
+  }
+  for (; fi < flen; fnow = (++fi < flen) ? f[fi] : 0)
+  {
+    twoSum(q, fnow, qnew, hh);
+    q = qnew;
+    if (hh != 0)
+      h.push_back(hh);
+  }
+  if (q != 0 || h.empty())
+    h.push_back(q);
+}
+
+/// h = e * b, dropping zero components
+inline void expansionScale(const Expansion &e, double b, Expansion &h)
+{
+  h.clear();
+  double q, hh, p1, p0, sum;
+  twoProduct(e[0], b, q, hh);
+  if (hh != 0)
+    h.push_back(hh);
+  for (size_t i = 1; i < e.size(); i++)
+  {
+    twoProduct(e[i], b, p1, p0);
+    twoSum(q, p0, sum, hh);
+    if (hh != 0)
+      h.push_back(hh);
+    fastTwoSum(p1, sum, q, hh);
+    if (hh != 0)
+      h.push_back(hh);
+  }
+  if (q != 0 || h.empty())
+    h.push_back(q);
+}
+
+/// e + f
+inline Expansion operator+(const Expansion &e, const Expansion &f)
+{
+  Expansion h;
+  expansionSum(e, f, h);
+  return h;
+}
+
+/// -e
+inline Expansion operator-(const Expansion &e)
+{
+  Expansion h(e);
+  for (size_t i = 0; i < h.size(); i++)
+    h[i] = -h[i];
+  return h;
+}
+
+/// e - f
+inline Expansion operator-(const Expansion &e, const Expansion &f)
+{
+  return e + (-f);
+}
+
+/// e * b
+inline Expansion operator*(const Expansion &e, double b)
+{
+  Expansion h;
+  expansionScale(e, b, h);
+  return h;
+}
+
+/// e * f, as the sum of f scaled by every component of e
+inline Expansion operator*(const Expansion &e, const Expansion &f)
+{
+  Expansion sum(1, 0.0), term, next;
+  for (size_t i = 0; i < e.size(); i++)
+  {
+    expansionScale(f, e[i], term);
+    expansionSum(sum, term, next);
+    sum.swap(next);
+  }
+  return sum;
+}
+
+/// Sign of an expansion, -1, 0 or 1
+inline int expansionSign(const Expansion &e)
+{
+  double top = e.back();
+  return (top > 0) - (top < 0);
+}
+
+/// Value of an expansion rounded to a double, up to a few units in the last place
+inline double expansionEstimate(const Expansion &e)
+{
+  double sum = 0;
+  for (size_t i = 0; i < e.size(); i++)
+    sum += e[i];
+  return sum;
+}
+
+/// Exact sign of (ax2 - ax1) * (by2 - by1) - (ay2 - ay1) * (bx2 - bx1)
+inline int crossSignExact(double ax1, double ay1, double ax2, double ay2,
+                          double bx1, double by1, double bx2, double by2)
+{
+  Expansion det = expansionDiff(ax2, ax1) * expansionDiff(by2, by1) -
+                  expansionDiff(ay2, ay1) * expansionDiff(bx2, bx1);
+  return expansionSign(det);
+}
+
+/// Sign of the cross product of the vectors a1 -> a2 and b1 -> b2
+///
+/// Positive if b turns counterclockwise from a, zero if they are parallel.
+inline int crossSign(double ax1, double ay1, double ax2, double ay2,
+                     double bx1, double by1, double bx2, double by2)
+{
+  double left = (ax2 - ax1) * (by2 - by1);
+  double right = (ay2 - ay1) * (bx2 - bx1);
+  double det = left - right;
+  double bound = ORIENT_BOUND * (fabs(left) + fabs(right));
+  if (det > bound)
+    return 1;
+  if (-det > bound)
+    return -1;
+  return crossSignExact(ax1, ay1, ax2, ay2, bx1, by1, bx2, by2);
+}
+
+/// Orientation of the triangle a, b, c
+/// @returns 1 if counterclockwise, -1 if clockwise, 0 if the points are collinear
+inline int orient2d(double ax, double ay, double bx, double by, double cx, double cy)
+{
+  return crossSign(ax, ay, bx, by, ax, ay, cx, cy);
+}
+
+/// Check if point c, collinear with a and b, lies on the segment ab
+inline bool onSegment(double ax, double ay, double bx, double by, double cx, double cy)
+{
+  return cx <= max(ax, bx) && cx >= min(ax, bx) && cy <= max(ay, by) && cy >= min(ay, by);
+}
+
+/// Check exactly if the closed segments ab and cd share a point
+inline bool segmentsIntersect(double ax, double ay, double bx, double by,
+                              double cx, double cy, double dx, double dy)
+{
+  int o1 = orient2d(ax, ay, bx, by, cx, cy);
+  int o2 = orient2d(ax, ay, bx, by, dx, dy);
+  int o3 = orient2d(cx, cy, dx, dy, ax, ay);
+  int o4 = orient2d(cx, cy, dx, dy, bx, by);
+  if (o1 != o2 && o3 != o4)
+    return true;
+  return (o1 == 0 && onSegment(ax, ay, bx, by, cx, cy)) || (o2 == 0 && onSegment(ax, ay, bx, by, dx, dy)) ||
+         (o3 == 0 && onSegment(cx, cy, dx, dy, ax, ay)) || (o4 == 0 && onSegment(cx, cy, dx, dy, bx, by));
+}
+
+/// Exact homogeneous coordinates (xn / den, yn / den) of the crossing of lines ab and cd
+///
+/// The lines must not be parallel.
+inline void intersectionExpansions(double ax, double ay, double bx, double by,
+                                   double cx, double cy, double dx, double dy,
+                                   Expansion &xn, Expansion &yn, Expansion &den)
+{
+  Expansion rx = expansionDiff(bx, ax), ry = expansionDiff(by, ay);
+  Expansion sx = expansionDiff(dx, cx), sy = expansionDiff(dy, cy);
+  den = rx * sy - ry * sx;
+  // the crossing is a + t (b - a) with t = ((c - a) x s) / den
+  Expansion t = expansionDiff(cx, ax) * sy - expansionDiff(cy, ay) * sx;
+  xn = den * ax + t * rx;
+  yn = den * ay + t * ry;
+}
+
+/// Sign of n - m * d for a double m lying between two neighbouring doubles q and q + 2h
+inline int midpointSign(const Expansion &n, const Expansion &d, double q, double h)
+{
+  return expansionSign(n - (d * q + d * h));
+}
+
+/// n / d correctly rounded to the nearest double, ties to even
+inline double roundQuotient(const Expansion &n, const Expansion &d)
+{
+  if (expansionSign(n) == 0)
+    return 0;
+  Expansion num = (expansionSign(d) < 0) ? -n : n;
+  Expansion den = (expansionSign(d) < 0) ? -d : d;
+  double q = expansionEstimate(num) / expansionEstimate(den);
+  while (true)
+  {
+    double up = nextafter(q, HUGE_VAL), down = nextafter(q, -HUGE_VAL);
+    int above = midpointSign(num, den, q, (up - q) / 2);
+    int below = midpointSign(num, den, q, (down - q) / 2);
+    if (above < 0 && below > 0)
+      return q;
+
+    unsigned long long bits;
+    memcpy(&bits, &q, sizeof(bits));
+    if (above == 0)
+      return (bits & 1) ? up : q;
+    if (below == 0)
+      return (bits & 1) ? down : q;
+    q = (above > 0) ? up : down;
+  }
+}
+
+/// Double-double number hi + lo, with lo at most half an ulp of hi
+struct DoubleDouble
+{
+  double hi; //!< Leading part
+  double lo; //!< Trailing part
+};
+
+/// Relative error bound of the double-double operations below, generously rounded up
+const double DOUBLE_DOUBLE_BOUND = 256.0 * PREDICATE_EPSILON * PREDICATE_EPSILON;
+
+/// a - b exactly
+inline DoubleDouble ddDiff(double a, double b)
+{
+  DoubleDouble r;
+  twoDiff(a, b, r.hi, r.lo);
+  return r;
+}
+
+/// a + b, with an error below DOUBLE_DOUBLE_BOUND * (|a| + |b|)
+inline DoubleDouble ddAdd(DoubleDouble a, DoubleDouble b)
+{
+  double s, e;
+  twoSum(a.hi, b.hi, s, e);
+  e += a.lo + b.lo;
+  DoubleDouble r;
+  fastTwoSum(s, e, r.hi, r.lo);
+  return r;
+}
+
+/// -a
+inline DoubleDouble ddNeg(DoubleDouble a)
+{
+  DoubleDouble r = {-a.hi, -a.lo};
+  return r;
+}
+
+/// a * b, with an error below DOUBLE_DOUBLE_BOUND * |a * b|
+inline DoubleDouble ddMul(DoubleDouble a, DoubleDouble b)
+{
+  double p, e;
+  twoProduct(a.hi, b.hi, p, e);
+  e += a.hi * b.lo + a.lo * b.hi;
+  DoubleDouble r;
+  fastTwoSum(p, e, r.hi, r.lo);
+  return r;
+}
+
+/// a / b, with an error below DOUBLE_DOUBLE_BOUND * |a / b|
+inline DoubleDouble ddDiv(DoubleDouble a, DoubleDouble b)
+{
+  double q1 = a.hi / b.hi;
+  DoubleDouble r = ddAdd(a, ddNeg(ddMul(b, DoubleDouble{q1, 0})));
+  double q2 = r.hi / b.hi;
+  DoubleDouble q;
+  fastTwoSum(q1, q2, q.hi, q.lo);
+  return q;
+}
+
+/// Crossing of the lines ab and cd in double-double arithmetic
+///
+/// Like the other predicates this assumes no underflow.
+/// @param err Receives a bound on the error of both coordinates
+/// @returns false if the lines are too close to parallel to bound the error
+inline bool intersectionApprox(double ax, double ay, double bx, double by,
+                               double cx, double cy, double dx, double dy,
+                               DoubleDouble &x, DoubleDouble &y, double &err)
+{
+  DoubleDouble rx = ddDiff(bx, ax), ry = ddDiff(by, ay);
+  DoubleDouble sx = ddDiff(dx, cx), sy = ddDiff(dy, cy);
+  DoubleDouble qx = ddDiff(cx, ax), qy = ddDiff(cy, ay);
+  DoubleDouble d1 = ddMul(rx, sy), d2 = ddMul(ry, sx), t1 = ddMul(qx, sy), t2 = ddMul(qy, sx);
+  DoubleDouble den = ddAdd(d1, ddNeg(d2)), tn = ddAdd(t1, ddNeg(t2));
+  double eden = 3 * DOUBLE_DOUBLE_BOUND * (fabs(d1.hi) + fabs(d2.hi));
+  double etn = 3 * DOUBLE_DOUBLE_BOUND * (fabs(t1.hi) + fabs(t2.hi));
+  if (!(fabs(den.hi) > 2 * eden))
+    return false;
+
+  // the crossing is a + t (b - a)
+  DoubleDouble t = ddDiv(tn, den);
+  double tmag = fabs(t.hi) * (1 + PREDICATE_EPSILON);
+  double et = 2 * (etn + tmag * eden) / fabs(den.hi) + DOUBLE_DOUBLE_BOUND * tmag;
+  x = ddAdd(DoubleDouble{ax, 0}, ddMul(t, rx));
+  y = ddAdd(DoubleDouble{ay, 0}, ddMul(t, ry));
+  double rmag = max(fabs(rx.hi), fabs(ry.hi)) * (1 + PREDICATE_EPSILON);
+  err = rmag * et + DOUBLE_DOUBLE_BOUND * (max(fabs(ax), fabs(ay)) + 2 * tmag * rmag);
+  return true;
+}
+
+/// Round a double-double value known to within err to the nearest double
+/// @returns false if the rounding is not certain
+inline bool roundCertain(DoubleDouble v, double err, double &out)
+{
+  double q = v.hi;
+  double up = (nextafter(q, HUGE_VAL) - q) / 2, down = (q - nextafter(q, -HUGE_VAL)) / 2;
+  if (v.lo + err < up && v.lo - err > -down)
+  {
+    out = q;
+    return true;
+  }
+  return false;
+}
+
+/// Sign of u - v for double-double values known to within eu and ev
+/// @returns -1 or 1, or 0 if the sign is not certain
+inline int ddCompare(DoubleDouble u, double eu, DoubleDouble v, double ev)
+{
+  DoubleDouble d = ddAdd(u, ddNeg(v));
+  double err = eu + ev + DOUBLE_DOUBLE_BOUND * (fabs(u.hi) + fabs(v.hi));
+  double mag = fabs(d.hi) * (1 - 2 * PREDICATE_EPSILON);
+  if (mag > err)
+    return (d.hi > 0) ? 1 : -1;
+  return 0;
+}
+
+/// Crossing of the lines ab and cd rounded to the nearest doubles
+///
+/// The point is first computed in double-double arithmetic with an error
+/// bound, which settles the rounding unless a coordinate lies extremely
+/// close to halfway between two doubles. The lines must not be parallel.
+inline void intersectionPoint(double ax, double ay, double bx, double by,
+                              double cx, double cy, double dx, double dy, double &x, double &y)
+{
+  DoubleDouble px, py;
+  double err;
+  if (intersectionApprox(ax, ay, bx, by, cx, cy, dx, dy, px, py, err) &&
+      roundCertain(px, err, x) && roundCertain(py, err, y))
+    return;
+
+  Expansion xn, yn, den;
+  intersectionExpansions(ax, ay, bx, by, cx, cy, dx, dy, xn, yn, den);
+  x = roundQuotient(xn, den);
+  y = roundQuotient(yn, den);
+}
+
+/// Sign of n1 / d1 - n2 / d2
+inline int compareQuotients(const Expansion &n1, const Expansion &d1, const Expansion &n2, const Expansion &d2)
+{
+  return expansionSign(n1 * d2 - n2 * d1) * expansionSign(d1) * expansionSign(d2);
+}
+
+/// Exact orientation of a, b and the point (xn / den, yn / den)
+/// @returns 1 if counterclockwise, -1 if clockwise, 0 if the points are collinear
+inline int orient2dExact(double ax, double ay, double bx, double by,
+                         const Expansion &xn, const Expansion &yn, const Expansion &den)
+{
+  Expansion det = expansionDiff(bx, ax) * (yn - den * ay) - expansionDiff(by, ay) * (xn - den * ax);
+  return expansionSign(det) * expansionSign(den);
+}
+
+#endif
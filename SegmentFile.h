@@ -0,0 +1,248 @@
+#ifndef SEGMENT_FILE_H
+#define SEGMENT_FILE_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "StatusQueue.h"
+using namespace std;
+
+/// Header at the start of a binary segment file.
+///
+/// The header is followed by count records of four coordinates each, in the
+/// order startX, startY, endX, endY, stored as float64 or float32 in the byte
+/// order of the machine that wrote the file.
+struct SegmentFileHeader
+{
+  char magic[4];        //!< Always "SWPL"
+  uint32_t version;     //!< Format version, currently 1
+  uint32_t precision;   //!< Bytes per coordinate, 8 or 4
+  uint32_t reserved;    //!< Zero
+  uint64_t count;       //!< Number of segments in the file
+  uint64_t reserved2;   //!< Zero
+};
+
+/// Write line segments to a binary segment file
+/// @param path Name of the file to create
+/// @param segmentVector Line segments to be written
+/// @param singlePrecision Store float32 coordinates instead of float64
+/// @returns false if the file could not be written
+inline bool writeSegmentFile(const char *path, const vector<LineSegment> &segmentVector, bool singlePrecision = false)
+{
+  FILE *f = fopen(path, "wb");
+  if (f == NULL)
+    return false;
+
+  SegmentFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "SWPL", 4);
+  header.version = 1;
+  header.precision = singlePrecision ? 4 : 8;
+  header.count = segmentVector.size();
+  bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+  // write in chunks so a large file never needs a second full copy in memory
+  const size_t chunk = 65536;
+  vector<double> wide;
+  vector<float> narrow;
+  for (size_t i = 0; ok && i < segmentVector.size(); i += chunk)
+  {
+    size_t n = min(chunk, segmentVector.size() - i);
+    wide.resize(4 * n);
+    for (size_t j = 0; j < n; j++)
+    {
+      const LineSegment &l = segmentVector[i + j];
+      wide[4 * j] = l.startX;
+      wide[4 * j + 1] = l.startY;
+      wide[4 * j + 2] = l.endX;
+      wide[4 * j + 3] = l.endY;
+    }
+    if (singlePrecision)
+    {
+      narrow.assign(wide.begin(), wide.end());
+      ok = fwrite(narrow.data(), sizeof(float), narrow.size(), f) == narrow.size();
+    }
+    else
+      ok = fwrite(wide.data(), sizeof(double), wide.size(), f) == wide.size();
+  }
+
+  if (fclose(f) != 0)
+    ok = false;
+  return ok;
+}
+
+/// Header at the start of a binary intersection file.
+///
+/// The header is followed by count records of x and y as float64 and the
+/// IDs a and b of the two segments as uint32, 24 bytes per record.
+struct IntersectionFileHeader
+{
+  char magic[4];        //!< Always "SWPI"
+  uint32_t version;     //!< Format version, currently 1
+  uint64_t count;       //!< Number of records in the file
+};
+
+/// Check if the start of a file holds the magic number of a binary segment file
+/// @returns false if the file cannot be read or holds anything else
+inline bool isSegmentFile(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+    return false;
+  char magic[4];
+  bool match = fread(magic, 1, 4, f) == 4 && memcmp(magic, "SWPL", 4) == 0;
+  fclose(f);
+  return match;
+}
+
+/// Read-only view of a binary segment file mapped into memory.
+///
+/// Segments are decoded on access, so the file is never copied into a
+/// vector of LineSegment. The view indexes like a vector and can be passed
+/// to FindIntersections in place of one.
+class MappedSegmentFile
+{
+  void *base;           //!< Start of the mapping
+  size_t length;        //!< Length of the mapping in bytes
+  const char *records;  //!< First coordinate after the header
+  size_t count;         //!< Number of segments
+  size_t precision;     //!< Bytes per coordinate
+  string message;       //!< Reason the last call to open failed
+
+public:
+  /// Create a view with no file mapped
+  MappedSegmentFile()
+  {
+    base = NULL;
+    length = 0;
+    records = NULL;
+    count = 0;
+    precision = 8;
+  }
+
+  /// Map a binary segment file
+  MappedSegmentFile(const char *path) : MappedSegmentFile()
+  {
+    open(path);
+  }
+
+  ~MappedSegmentFile()
+  {
+    close();
+  }
+
+  MappedSegmentFile(const MappedSegmentFile &) = delete;
+  MappedSegmentFile &operator=(const MappedSegmentFile &) = delete;
+
+  /// Map a binary segment file, unmapping the previous one
+  /// @returns false if the file is missing or malformed, see error()
+  bool open(const char *path)
+  {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0)
+      return fail(string("cannot open ") + path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SegmentFileHeader))
+    {
+      ::close(fd);
+      return fail(string(path) + " is too short for a segment file");
+    }
+    length = st.st_size;
+    base = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+    {
+      base = NULL;
+      return fail(string("cannot map ") + path);
+    }
+
+    SegmentFileHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, "SWPL", 4) != 0 || header.version != 1)
+      return fail(string(path) + " is not a segment file");
+    if (header.precision != 4 && header.precision != 8)
+      return fail(string(path) + " has an unknown coordinate precision");
+    if (header.count > (length - sizeof(header)) / (4 * header.precision))
+      return fail(string(path) + " is truncated");
+
+    // the sweep reads every record once, front to back
+    madvise(base, length, MADV_SEQUENTIAL);
+    records = (const char *)base + sizeof(header);
+    count = header.count;
+    precision = header.precision;
+    return true;
+  }
+
+  /// Unmap the file
+  void close()
+  {
+    if (base != NULL)
+      munmap(base, length);
+    base = NULL;
+    length = 0;
+    records = NULL;
+    count = 0;
+  }
+
+  /// Why the last call to open failed
+  const string &error() const
+  {
+    return message;
+  }
+
+  /// Number of segments in the file
+  size_t size() const
+  {
+    return count;
+  }
+
+  /// Check if the file stores float32 coordinates
+  bool singlePrecision() const
+  {
+    return precision == 4;
+  }
+
+  /// Line segment with a given ID
+  LineSegment operator[](size_t i) const
+  {
+    LineSegment l;
+    if (precision == 8)
+    {
+      double c[4];
+      memcpy(c, records + 32 * i, sizeof(c));
+      l.startX = c[0];
+      l.startY = c[1];
+      l.endX = c[2];
+      l.endY = c[3];
+    }
+    else
+    {
+      float c[4];
+      memcpy(c, records + 16 * i, sizeof(c));
+      l.startX = c[0];
+      l.startY = c[1];
+      l.endX = c[2];
+      l.endY = c[3];
+    }
+    return l;
+  }
+
+private:
+  /// Record an error and drop the mapping
+  bool fail(const string &why)
+  {
+    close();
+    message = why;
+    return false;
+  }
+};
+
+#endif
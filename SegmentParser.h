@@ -0,0 +1,261 @@
+#ifndef SEGMENT_PARSER_H
+#define SEGMENT_PARSER_H
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+#include "ParallelSort.h"
+#include "StatusQueue.h"
+using namespace std;
+
+/// Parse one number starting at p, skipping spaces and tabs before it
+///
+/// Uses from_chars when the library provides it for floating point. Older
+/// compilers fall back to strtod on a copy of the token.
+/// @returns Pointer just past the number, or NULL if there is none before end
+inline const char *parseNumber(const char *p, const char *end, double &value)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  if (p < end && *p == '+')
+    p++;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  from_chars_result r = from_chars(p, end, value);
+  return (r.ec == errc() && r.ptr != p) ? r.ptr : NULL;
+#else
+  char token[64];
+  size_t n = 0;
+  while (p + n < end && n + 1 < sizeof(token) && strchr(" \t\r\n", p[n]) == NULL)
+  {
+    token[n] = p[n];
+    n++;
+  }
+  token[n] = '\0';
+  char *stop;
+  value = strtod(token, &stop);
+  return (stop == token) ? NULL : p + (stop - token);
+#endif
+}
+
+/// Check if a line holds nothing but whitespace
+inline bool blankLine(const char *p, const char *end)
+{
+  for (; p < end; p++)
+  {
+    if (*p != ' ' && *p != '\t' && *p != '\r')
+      return false;
+  }
+  return true;
+}
+
+/// Parse the text segment format with several threads.
+///
+/// The text holds the number of segments followed by one segment per line,
+/// x1 y1 x2 y2 separated by whitespace. Blank lines are ignored, and every
+/// number must be finite. The text is cut into one chunk per thread at line
+/// boundaries. A first pass counts the lines and segment lines of every
+/// chunk, so that the second pass can parse each chunk straight into its
+/// slice of the output and report malformed lines by number.
+/// @param begin First character of the text
+/// @param end One past the last character of the text
+/// @param segmentVector Receives the segments, resized to the declared count
+/// @param threads Number of threads to use, 0 for one per core
+/// @param error Receives the reason on failure
+/// @returns false if the text is malformed
+inline bool parseSegmentText(const char *begin, const char *end, vector<LineSegment> &segmentVector,
+                             unsigned int threads, string &error)
+{
+  // header: the number of segments on the first non blank line
+  const char *p = begin;
+  while (p < end && strchr(" \t\r\n", *p) != NULL)
+    p++;
+  double count;
+  p = parseNumber(p, end, count);
+  if (p == NULL || !isfinite(count) || count < 0 || count != (double)(size_t)count)
+  {
+    error = "missing segment count";
+    return false;
+  }
+  size_t countLine = 1;
+  for (const char *q = begin; q < p; q++)
+    countLine += (*q == '\n');
+  const char *eol = (const char *)memchr(p, '\n', end - p);
+  eol = (eol == NULL) ? end : eol;
+  if (!blankLine(p, eol))
+  {
+    error = "line " + to_string(countLine) + ": unexpected text after the segment count";
+    return false;
+  }
+  const char *body = (eol == end) ? end : eol + 1;
+
+  if (threads == 0)
+    threads = defaultThreads();
+  size_t bytes = end - body;
+  if (bytes < ((size_t)1 << 20))
+    threads = 1;
+
+  // chunk c covers [cuts[c], cuts[c + 1]) and starts at the beginning of a line
+  vector<const char *> cuts(threads + 1, end);
+  cuts[0] = body;
+  for (unsigned int c = 1; c < threads; c++)
+  {
+    const char *q = body + bytes * c / threads;
+    if (q < cuts[c - 1])
+      q = cuts[c - 1];
+    const char *nl = (const char *)memchr(q, '\n', end - q);
+    cuts[c] = (nl == NULL) ? end : nl + 1;
+  }
+
+  vector<size_t> first(threads + 1, 0);
+  vector<size_t> firstLine(threads + 1, countLine);
+  vector<string> errors(threads);
+  vector<thread> workers;
+
+  // first pass: count the lines and segment lines of every chunk
+  for (unsigned int c = 0; c < threads; c++)
+  {
+    workers.push_back(thread([&cuts, &first, &firstLine, c]() {
+      size_t lines = 0, segments = 0;
+      for (const char *q = cuts[c]; q < cuts[c + 1];)
+      {
+        const char *nl = (const char *)memchr(q, '\n', cuts[c + 1] - q);
+        const char *eol = (nl == NULL) ? cuts[c + 1] : nl;
+        if (!blankLine(q, eol))
+          segments++;
+        lines++;
+        q = eol + 1;
+      }
+      first[c + 1] = segments;
+      firstLine[c + 1] = lines;
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+  for (unsigned int c = 0; c < threads; c++)
+  {
+    first[c + 1] += first[c];
+    firstLine[c + 1] += firstLine[c];
+  }
+
+  if (first[threads] != (size_t)count)
+  {
+    error = "expected " + to_string((size_t)count) + " segments, found " + to_string(first[threads]);
+    return false;
+  }
+  segmentVector.resize(first[threads]);
+
+  // second pass: parse every chunk into its own slice
+  workers.clear();
+  for (unsigned int c = 0; c < threads; c++)
+  {
+    workers.push_back(thread([&cuts, &first, &firstLine, &errors, &segmentVector, c]() {
+      size_t i = first[c], line = firstLine[c];
+      for (const char *q = cuts[c]; q < cuts[c + 1];)
+      {
+        line++;
+        const char *nl = (const char *)memchr(q, '\n', cuts[c + 1] - q);
+        const char *eol = (nl == NULL) ? cuts[c + 1] : nl;
+        if (!blankLine(q, eol))
+        {
+          double v[4];
+          const char *r = q;
+          if ((r = parseNumber(r, eol, v[0])) == NULL || (r = parseNumber(r, eol, v[1])) == NULL ||
+              (r = parseNumber(r, eol, v[2])) == NULL || (r = parseNumber(r, eol, v[3])) == NULL ||
+              !blankLine(r, eol))
+          {
+            errors[c] = "line " + to_string(line) + ": segment " + to_string(i) + " is not four numbers";
+            return;
+          }
+          // rounds to float when built with SWEEP_FLOAT32, which may overflow
+          LineSegment &l = segmentVector[i];
+          l.startX = v[0];
+          l.startY = v[1];
+          l.endX = v[2];
+          l.endY = v[3];
+          if (!isfinite(l.startX) || !isfinite(l.startY) || !isfinite(l.endX) || !isfinite(l.endY))
+          {
+            errors[c] = "line " + to_string(line) + ": segment " + to_string(i) + " is not four finite numbers";
+            return;
+          }
+          i++;
+        }
+        q = eol + 1;
+      }
+    }));
+  }
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  for (unsigned int c = 0; c < threads; c++)
+  {
+    if (!errors[c].empty())
+    {
+      error = errors[c];
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Parse a text segment file with several threads
+///
+/// Regular files are mapped, anything else (such as "-" for stdin) is read
+/// into memory first.
+/// @param path Name of the file, "-" for stdin
+/// @param segmentVector Receives the segments
+/// @param threads Number of threads to use, 0 for one per core
+/// @param error Receives the reason on failure
+/// @returns false if the file cannot be read or is malformed
+inline bool parseSegmentTextFile(const char *path, vector<LineSegment> &segmentVector,
+                                 unsigned int threads, string &error)
+{
+  int fd = (strcmp(path, "-") == 0) ? 0 : open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    error = string("cannot open ") + path;
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+  {
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (base != MAP_FAILED)
+    {
+      if (fd != 0)
+        close(fd);
+      madvise(base, st.st_size, MADV_SEQUENTIAL);
+      const char *text = (const char *)base;
+      bool ok = parseSegmentText(text, text + st.st_size, segmentVector, threads, error);
+      munmap(base, st.st_size);
+      return ok;
+    }
+  }
+
+  string text;
+  char buffer[1 << 16];
+  ssize_t n;
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0)
+    text.append(buffer, n);
+  if (fd != 0)
+    close(fd);
+  if (n < 0)
+  {
+    error = string("cannot read ") + path;
+    return false;
+  }
+  return parseSegmentText(text.data(), text.data() + text.size(), segmentVector, threads, error);
+}
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "FindIntersections.h"
+#include "ParallelSort.h"
+using namespace std;
+
+/// Largest number of slabs the command line tools accept
+const unsigned int MAX_SLABS = 65536;
+
+/// Parallel intersection engine that sweeps horizontal slabs independently.
+///
+/// The plane is cut by k - 1 horizontal lines into slabs holding roughly the
+/// same number of endpoints. Every slab is swept by its own FindIntersections
+/// on a pool of threads, over the segments meeting it. The segments are not
+/// clipped: they keep their exact coordinates, and only the event points
+/// swept are limited to the slab. Segments from above enter at their exact
+/// crossing with the top boundary. Slab boundaries are placed strictly
+/// between endpoint y-coordinates, so no endpoint lies on one. Each event
+/// point, a point on a boundary included, belongs to exactly one slab, and
+/// so does each pair: collinear segments overlapping across a boundary are
+/// reported by the slab holding the top of their overlap. Records report the
+/// IDs of the input segments.
+class SlabIntersections
+{
+  private:
+    vector<double> boundaries;                 //!< Y-coordinates separating the slabs, top to bottom
+    vector<vector<LineSegment> > pieces;       //!< Segments meeting each slab, top slab first
+    vector<vector<unsigned int> > origin;      //!< ID of the input segment of each piece
+    vector<vector<IntersectionRecord> > slabResults;  //!< Intersections found in each slab
+    vector<SweepStats> slabStats;              //!< Counters of the sweep of each slab
+    StatusEngine statusEngine;
+    EventEngine eventEngine;
+    unsigned int threads;
+
+  public:
+    /// Constructor to cut the segments into slabs
+    /// @param segmentVector Line segments to be checked for intersections
+    /// @param slabs Number of slabs, 0 for one per thread
+    /// @param threadCount Number of threads sweeping slabs, 0 for one per core
+    /// @param engine Data structure used for the status queue of each slab
+    /// @param events Data structure used for the event queue of each slab
+    SlabIntersections(vector<LineSegment> &segmentVector, unsigned int slabs = 0, unsigned int threadCount = 0,
+                      StatusEngine engine = AVL_STATUS, EventEngine events = AVL_EVENTS)
+    {
+      threads = (threadCount == 0) ? defaultThreads() : threadCount;
+      if (slabs == 0)
+        slabs = threads;
+      statusEngine = engine;
+      eventEngine = events;
+
+      findBoundaries(segmentVector, slabs);
+      pieces.resize(boundaries.size() + 1);
+      origin.resize(boundaries.size() + 1);
+      slabResults.resize(boundaries.size() + 1);
+      slabStats.resize(boundaries.size() + 1);
+
+      for (size_t i = 0; i < segmentVector.size(); i++)
+      {
+        LineSegment l = segmentVector[i];
+        if (l.startY < l.endY)
+        {
+          swap(l.startX, l.endX);
+          swap(l.startY, l.endY);
+        }
+        assign(l, i);
+      }
+    }
+
+    /// Number of slabs the plane was cut into
+    size_t slabCount()
+    {
+      return pieces.size();
+    }
+
+    /// Run the algorithm on every slab and merge the intersections
+    /// @param out Receives one record per pair of intersecting segments, in sweep order
+    void runAlgorithm(vector<IntersectionRecord> &out)
+    {
+      atomic<size_t> next(0);
+      vector<thread> workers;
+      size_t count = min((size_t)threads, pieces.size());
+      for (size_t t = 0; t < count; t++)
+      {
+        workers.push_back(thread([this, &next]() {
+          for (size_t s = next++; s < pieces.size(); s = next++)
+            sweepSlab(s);
+        }));
+      }
+      for (size_t t = 0; t < workers.size(); t++)
+        workers[t].join();
+
+      // slabs are ordered top to bottom, so concatenating keeps the sweep order
+      for (size_t s = 0; s < slabResults.size(); s++)
+      {
+        out.insert(out.end(), slabResults[s].begin(), slabResults[s].end());
+        vector<IntersectionRecord>().swap(slabResults[s]);
+      }
+    }
+
+    /// Run the algorithm on every slab and merge the intersections
+    /// @returns One record per pair of intersecting segments, in sweep order
+    vector<IntersectionRecord> runAlgorithm()
+    {
+      vector<IntersectionRecord> out;
+      runAlgorithm(out);
+      return out;
+    }
+
+    /// Counters of all slab sweeps, all zero unless compiled with SWEEP_STATS
+    ///
+    /// Counts are summed over the slabs, maxima are the largest of any slab.
+    SweepStats stats()
+    {
+      SweepStats all;
+      for (size_t s = 0; s < slabStats.size(); s++)
+        all.merge(slabStats[s]);
+      return all;
+    }
+
+  private:
+    /// Choose slab boundaries so that every slab gets about the same number of endpoints
+    ///
+    /// Boundaries are picked among coordinates lying strictly between two
+    /// distinct endpoint y-coordinates.
+    void findBoundaries(vector<LineSegment> &segmentVector, unsigned int slabs)
+    {
+      vector<double> ys;
+      ys.reserve(2 * segmentVector.size());
+      for (size_t i = 0; i < segmentVector.size(); i++)
+      {
+        ys.push_back(segmentVector[i].startY);
+        ys.push_back(segmentVector[i].endY);
+      }
+      parallelSort(ys, greater<double>(), threads);
+      ys.erase(unique(ys.begin(), ys.end()), ys.end());
+
+      for (unsigned int k = 1; k < slabs; k++)
+      {
+        size_t q = ys.size() * k / slabs;
+        for (; q + 1 < ys.size(); q++)
+        {
+          double mid = (Coordinate)(ys[q] / 2 + ys[q + 1] / 2);
+          if (mid < ys[q] && mid > ys[q + 1] && (boundaries.empty() || mid < boundaries.back()))
+          {
+            boundaries.push_back(mid);
+            break;
+          }
+        }
+      }
+    }
+
+    /// Add a segment to every slab it passes through
+    /// @param l Line segment with the upper endpoint first
+    /// @param id ID of the line segment
+    void assign(const LineSegment &l, size_t id)
+    {
+      // slabs are numbered from the top, boundaries[s] is the bottom of slab s
+      size_t first = lower_bound(boundaries.begin(), boundaries.end(), l.startY, greater<double>()) - boundaries.begin();
+      size_t last = lower_bound(boundaries.begin(), boundaries.end(), l.endY, greater<double>()) - boundaries.begin();
+
+      for (size_t s = first; s <= last; s++)
+      {
+        pieces[s].push_back(l);
+        origin[s].push_back((unsigned int)id);
+      }
+    }
+
+    /// Sweep one slab and map the records back to the input segments
+    void sweepSlab(size_t s)
+    {
+      double top = (s == 0) ? INFINITY : boundaries[s - 1];
+      double bottom = (s == boundaries.size()) ? -INFINITY : boundaries[s];
+      vector<IntersectionRecord> &found = slabResults[s];
+      found.clear();
+      FindIntersections slab(pieces[s], top, bottom, statusEngine, eventEngine);
+      slab.runAlgorithm(found);
+      slabStats[s] = slab.stats();
+
+      for (size_t i = 0; i < found.size(); i++)
+      {
+        found[i].a = origin[s][found[i].a];
+        found[i].b = origin[s][found[i].b];
+        if (found[i].a > found[i].b)
+          swap(found[i].a, found[i].b);
+      }
+    }
+};
+
+#endif
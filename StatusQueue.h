@@ -1,50 +1,456 @@
 #ifndef STATUS_H
 #define STATUS_H
 
+#include <algorithm>
 #include <stdlib.h>
 #include <vector>
 #include<iostream>
+#include"NodePool.h"
+#include"Predicates.h"
+#include"IntegerPredicates.h"
+#include"SweepStats.h"
 using namespace std;
 
 
+/// Type of the stored segment coordinates.
+///
+/// Compile with -DSWEEP_FLOAT32 to store them as floats, which halves the
+/// size of LineSegment. Input coordinates are then rounded to float when
+/// they are read; the predicates widen them back to double and stay exact
+/// for the rounded segments.
+#ifdef SWEEP_FLOAT32
+typedef float Coordinate;
+#else
+typedef double Coordinate;
+#endif
+
+
 /// Structure to store a line segment.
 ///
 /// Stored as four coordinates signifying start and end points.
 struct LineSegment
 {
-  double startX; //!< X-coordinate of start point
-  double startY; //!< Y-coordinate of start point
-  double endX;   //!< X-coordinate of end point
-  double endY;   //!< Y-coordinate of end point
+  Coordinate startX; //!< X-coordinate of start point
+  Coordinate startY; //!< Y-coordinate of start point
+  Coordinate endX;   //!< X-coordinate of end point
+  Coordinate endY;   //!< Y-coordinate of end point
+};
+
+
+/// Segment ID used to signify that no segment was found
+const unsigned int NO_SEGMENT = 0xFFFFFFFF;
+
+
+/// Exact order of the line segments crossing the sweep line at an event point.
+///
+/// The sweep line passes through the current event point p. Segments are
+/// ordered by where they cross it; segments passing through p are ordered by
+/// direction just below p when they are inserted and just above p when they
+/// are deleted, and collinear ones by ID. A horizontal segment is treated as
+/// crossing the sweep line at p for as long as it is in the status queue.
+/// All tests are exact predicates on the input coordinates, or on the exact
+/// intersection point of the two segments that created p.
+///
+/// When every coordinate lies on the 32-bit integer grid, the exact
+/// fallbacks use the 128-bit integer predicates instead of expansions.
+///
+/// Line segments must have the upper endpoint first.
+class SweepOrder
+{
+
+public:
+  /// Line segments indexed by segment ID
+  const vector<LineSegment> *segments;
+
+  /// Whether every coordinate lies on the integer grid of IntegerPredicates.h
+  bool integer;
+
+  double x;       //!< X-coordinate of the current event point
+  double y;       //!< Y-coordinate of the current event point
+  unsigned int a; //!< First segment crossing at the event point, NO_SEGMENT for endpoints
+  unsigned int b; //!< Second segment crossing at the event point
+
+  bool approximated; //!< Whether approximating the event point was tried
+  bool approxValid;  //!< Whether px, py and perr hold the event point
+  DoubleDouble px;   //!< X-coordinate of the event point in double-double
+  DoubleDouble py;   //!< Y-coordinate of the event point in double-double
+  double perr;       //!< Error bound of px and py
+
+  bool exact;     //!< Whether the exact event point is computed, in point if integer, else in xn, yn and den
+  Expansion xn;   //!< Exact x-coordinate of the event point times den
+  Expansion yn;   //!< Exact y-coordinate of the event point times den
+  Expansion den;  //!< Denominator of the exact event point
+  RationalPoint point; //!< Exact event point on the integer grid
+
+  /// Comparison counters, updated when compiled with SWEEP_STATS
+  SweepStats stats;
+
+  /// Basic constructor
+  /// @param segs Line segments indexed by segment ID
+  SweepOrder(const vector<LineSegment> *segs)
+  {
+    segments = segs;
+    integer = false;
+    moveTo(0, 0, NO_SEGMENT, NO_SEGMENT);
+  }
+
+  /// Move the sweep line to an event point
+  /// @param xc X-coordinate of the event point
+  /// @param yc Y-coordinate of the event point
+  /// @param first, second Segments whose intersection is the event point, NO_SEGMENT for endpoints
+  void moveTo(double xc, double yc, unsigned int first, unsigned int second)
+  {
+    x = xc;
+    y = yc;
+    a = first;
+    b = second;
+    approximated = false;
+    exact = false;
+  }
+
+  /// Position of the event point relative to a segment crossing the sweep line
+  /// @returns -1 if the point is left of the segment, 1 if right, 0 if on it
+  int side(const LineSegment &t, unsigned int id)
+  {
+    SWEEP_COUNT(stats, comparisons);
+    if (id == a || id == b)
+      return 0;
+    if (a == NO_SEGMENT)
+    {
+      if ((t.startX == x && t.startY == y) || (t.endX == x && t.endY == y))
+        return 0;
+      if (integer)
+        return orient2dInteger(t.startX, t.startY, t.endX, t.endY, x, y);
+      return orient2d(t.startX, t.startY, t.endX, t.endY, x, y);
+    }
+
+    // filter first with the rounded point, which is within half an ulp of the exact one
+    double dx = (double)t.endX - t.startX, dy = (double)t.endY - t.startY;
+    double left = dx * (y - t.startY), right = dy * (x - t.startX);
+    double det = left - right;
+    double bound = ORIENT_BOUND * (fabs(left) + fabs(right)) +
+                   2 * PREDICATE_EPSILON * (fabs(dx) * fabs(y) + fabs(dy) * fabs(x));
+    if (det > bound)
+      return 1;
+    if (-det > bound)
+      return -1;
+
+    if (integer)
+    {
+      if (!exact)
+      {
+        const LineSegment &p = (*segments)[a], &q = (*segments)[b];
+        point = intersectionRational(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY);
+        exact = true;
+      }
+      return orient2dRational(t.startX, t.startY, t.endX, t.endY, point);
+    }
+
+    // then with the point in double-double
+    if (!approximated)
+    {
+      const LineSegment &p = (*segments)[a], &q = (*segments)[b];
+      approxValid = intersectionApprox(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY,
+                                       px, py, perr);
+      approximated = true;
+    }
+    if (approxValid)
+    {
+      DoubleDouble ddx = ddDiff(t.endX, t.startX), ddy = ddDiff(t.endY, t.startY);
+      DoubleDouble rel = ddAdd(ddMul(ddx, ddAdd(py, DoubleDouble{-t.startY, 0})),
+                               ddNeg(ddMul(ddy, ddAdd(px, DoubleDouble{-t.startX, 0}))));
+      double err = (fabs(dx) + fabs(dy)) * perr * (1 + 4 * PREDICATE_EPSILON) +
+                   4 * DOUBLE_DOUBLE_BOUND * (fabs(dx) * (fabs(py.hi) + fabs(t.startY)) + fabs(dy) * (fabs(px.hi) + fabs(t.startX)));
+      if (fabs(rel.hi) * (1 - 2 * PREDICATE_EPSILON) > err)
+        return (rel.hi > 0) ? 1 : -1;
+    }
+
+    if (!exact)
+    {
+      const LineSegment &p = (*segments)[a], &q = (*segments)[b];
+      intersectionExpansions(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY, xn, yn, den);
+      exact = true;
+    }
+    return orient2dExact(t.startX, t.startY, t.endX, t.endY, xn, yn, den);
+  }
+
+  /// Sign of the cross product of the directions of two segments
+  ///
+  /// Positive if t turns counterclockwise from s, zero if they are parallel.
+  int turn(const LineSegment &s, const LineSegment &t)
+  {
+    if (integer)
+      return crossSignInteger(s.startX, s.startY, s.endX, s.endY, t.startX, t.startY, t.endX, t.endY);
+    return crossSign(s.startX, s.startY, s.endX, s.endY, t.startX, t.startY, t.endX, t.endY);
+  }
+
+  /// Order of two segments passing through the event point
+  /// @param below true for the order just below the point, false for just above it
+  /// @returns -1 if s is left of t, 1 if right, 0 if s is t
+  int direction(const LineSegment &s, unsigned int sId, const LineSegment &t, unsigned int tId, bool below)
+  {
+    if (sId == tId)
+      return 0;
+    int c = turn(s, t);
+    if (c != 0)
+      return below ? -c : c;
+    return (sId < tId) ? -1 : 1;
+  }
+
+  /// Position of a segment through the event point relative to another segment, just below the point
+  /// @returns -1 if s is left of t, 1 if right, 0 if s is t
+  int compareBelow(const LineSegment &s, unsigned int sId, const LineSegment &t, unsigned int tId)
+  {
+    int c = side(t, tId);
+    return (c != 0) ? c : direction(s, sId, t, tId, true);
+  }
+
+  /// Position of a segment through the event point relative to another segment, just above the point
+  /// @returns -1 if s is left of t, 1 if right, 0 if s is t
+  int compareAbove(const LineSegment &s, unsigned int sId, const LineSegment &t, unsigned int tId)
+  {
+    int c = side(t, tId);
+    return (c != 0) ? c : direction(s, sId, t, tId, false);
+  }
+
+  /// Position of the event point relative to a segment given by its ID
+  int side(unsigned int t)
+  {
+    return side((*segments)[t], t);
+  }
+
+  /// Position of segment s relative to segment t just below the event point, by ID
+  int compareBelow(unsigned int s, unsigned int t)
+  {
+    return compareBelow((*segments)[s], s, (*segments)[t], t);
+  }
+
+  /// Position of segment s relative to segment t just above the event point, by ID
+  int compareAbove(unsigned int s, unsigned int t)
+  {
+    return compareAbove((*segments)[s], s, (*segments)[t], t);
+  }
+
+  /// Exact homogeneous coordinates (xn / den, yn / den) of an event point
+  ///
+  /// Endpoints are exact already, intersection points are recomputed from the
+  /// two segments that created them.
+  /// @param first, second Segments whose intersection is the point, NO_SEGMENT for endpoints
+  void exactEventPoint(double xc, double yc, unsigned int first, unsigned int second,
+                       Expansion &xe, Expansion &ye, Expansion &de)
+  {
+    if (first == NO_SEGMENT)
+    {
+      xe.assign(1, xc);
+      ye.assign(1, yc);
+      de.assign(1, 1.0);
+      return;
+    }
+    const LineSegment &p = (*segments)[first], &q = (*segments)[second];
+    intersectionExpansions(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY, xe, ye, de);
+  }
+
+  /// Exact event point on the integer grid
+  /// @param first, second Segments whose intersection is the point, NO_SEGMENT for endpoints
+  RationalPoint rationalEventPoint(double xc, double yc, unsigned int first, unsigned int second)
+  {
+    if (first == NO_SEGMENT)
+      return rationalPoint(xc, yc);
+    const LineSegment &p = (*segments)[first], &q = (*segments)[second];
+    return intersectionRational(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY);
+  }
+
+  /// Event point in double-double arithmetic
+  /// @param first, second Segments whose intersection is the point, NO_SEGMENT for endpoints
+  /// @param err Receives a bound on the error of both coordinates
+  /// @returns false if the error could not be bounded
+  bool approxEventPoint(double xc, double yc, unsigned int first, unsigned int second,
+                        DoubleDouble &ax, DoubleDouble &ay, double &err)
+  {
+    if (first == NO_SEGMENT)
+    {
+      ax = DoubleDouble{xc, 0};
+      ay = DoubleDouble{yc, 0};
+      err = 0;
+      return true;
+    }
+    const LineSegment &p = (*segments)[first], &q = (*segments)[second];
+    return intersectionApprox(p.startX, p.startY, p.endX, p.endY, q.startX, q.startY, q.endX, q.endY, ax, ay, err);
+  }
+
+  /// Check cheaply if the y-coordinate of an event point is known to be exact
+  ///
+  /// True for endpoints and for crossings with a horizontal segment.
+  bool exactEventY(unsigned int first, unsigned int second)
+  {
+    const vector<LineSegment> &s = *segments;
+    return first == NO_SEGMENT || s[first].startY == s[first].endY || s[second].startY == s[second].endY;
+  }
+
+  /// Check cheaply if the x-coordinate of an event point is known to be exact
+  ///
+  /// True for endpoints and for crossings with a vertical segment.
+  bool exactEventX(unsigned int first, unsigned int second)
+  {
+    const vector<LineSegment> &s = *segments;
+    return first == NO_SEGMENT || s[first].startX == s[first].endX || s[second].startX == s[second].endX;
+  }
+
+  /// Compare two event points in the order they are popped
+  ///
+  /// Rounding keeps the order of distinct coordinates, so the exact points are
+  /// only needed when a rounded coordinate ties and is not known to be exact.
+  /// Crossings that round to the same doubles are then still told apart, by
+  /// double-double approximations when they are far enough apart and exactly
+  /// otherwise.
+  /// @param a1, b1 Segments whose intersection is the first point, NO_SEGMENT for endpoints
+  /// @param a2, b2 Segments whose intersection is the second point, NO_SEGMENT for endpoints
+  /// @returns -1 if the first point is popped first, 1 if the second is, 0 if they are the same point
+  int compareEvents(double x1, double y1, unsigned int a1, unsigned int b1,
+                    double x2, double y2, unsigned int a2, unsigned int b2)
+  {
+    if (y1 != y2)
+      return (y1 > y2) ? -1 : 1;
+    if ((a1 == a2 && b1 == b2) || (a1 == b2 && b1 == a2))
+      return (x1 != x2) ? ((x1 < x2) ? -1 : 1) : 0;
+    if (integer)
+      return compareRationalEvents(x1, y1, a1, b1, x2, y2, a2, b2);
+
+    Expansion xn1, yn1, den1, xn2, yn2, den2;
+    bool computed = false;
+    if (!exactEventY(a1, b1) || !exactEventY(a2, b2))
+    {
+      DoubleDouble px1, py1, px2, py2;
+      double e1, e2;
+      if (approxEventPoint(x1, y1, a1, b1, px1, py1, e1) &&
+          approxEventPoint(x2, y2, a2, b2, px2, py2, e2))
+      {
+        int c = ddCompare(py2, e2, py1, e1);
+        if (c != 0)
+          return c;
+      }
+
+      exactEventPoint(x1, y1, a1, b1, xn1, yn1, den1);
+      exactEventPoint(x2, y2, a2, b2, xn2, yn2, den2);
+      computed = true;
+      int c = compareQuotients(yn2, den2, yn1, den1);
+      if (c != 0)
+        return c;
+    }
+
+    // the y-coordinates are equal, so the x-coordinates decide
+    if (x1 != x2)
+      return (x1 < x2) ? -1 : 1;
+    if (exactEventX(a1, b1) && exactEventX(a2, b2))
+      return 0;
+    if (!computed)
+    {
+      exactEventPoint(x1, y1, a1, b1, xn1, yn1, den1);
+      exactEventPoint(x2, y2, a2, b2, xn2, yn2, den2);
+    }
+    return compareQuotients(xn1, den1, xn2, den2);
+  }
+
+  /// compareEvents for rounded y-coordinates that tie on the integer grid
+  int compareRationalEvents(double x1, double y1, unsigned int a1, unsigned int b1,
+                            double x2, double y2, unsigned int a2, unsigned int b2)
+  {
+    RationalPoint p1, p2;
+    bool computed = false;
+    if (!exactEventY(a1, b1) || !exactEventY(a2, b2))
+    {
+      p1 = rationalEventPoint(x1, y1, a1, b1);
+      p2 = rationalEventPoint(x2, y2, a2, b2);
+      computed = true;
+      int c = compareRationals(p2.yn, p2.den, p1.yn, p1.den);
+      if (c != 0)
+        return c;
+    }
+
+    if (x1 != x2)
+      return (x1 < x2) ? -1 : 1;
+    if (exactEventX(a1, b1) && exactEventX(a2, b2))
+      return 0;
+    if (!computed)
+    {
+      p1 = rationalEventPoint(x1, y1, a1, b1);
+      p2 = rationalEventPoint(x2, y2, a2, b2);
+    }
+    return compareRationals(p1.xn, p1.den, p2.xn, p2.den);
+  }
 };
 
 
 /// Strucutre to represent a node of the status queue.
 /// 
-/// Line segment is used as a key.
+/// Line segment is used as a key. Segments are stored in the leaves; an
+/// inner node holds the rightmost segment of its left subtree. The leaves
+/// are also linked left to right, so neighbours are one step away.
 struct StatusQueueNode
 {
-  LineSegment l; //!< Line segment used as a key for the node
+  unsigned int l; //!< ID of the line segment used as a key for the node
   StatusQueueNode *left; //!< Pointer to left child in the search tree
   StatusQueueNode *right; //!< Pointer to right child in the search tree
+  StatusQueueNode *parent; //!< Pointer to parent in the search tree, NULL for the root
+  StatusQueueNode *prev; //!< For leaves, the leaf to the left, NULL for the leftmost
+  StatusQueueNode *next; //!< For leaves, the leaf to the right, NULL for the rightmost
   int height;   //!< Height of the node in the search tree
 };
 
 
 /// Implementation of the status queue data strucuture.
 ///
-/// Uses a balanced binary search tree called **AVL Tree**.
+/// Uses a balanced binary search tree called **AVL Tree**, searched with the
+/// exact SweepOrder at the current event point. Updates walk back up the
+/// parent pointers instead of recursing, and stop as soon as a subtree keeps
+/// its height. The leaf of every segment in the tree is kept by segment ID,
+/// so deletions and neighbour lookups of such segments need no search.
 class StatusQueue
 {
 
 public:
-  /// globalinsert variable to signify inserting two nodes for each line
-  int globalinsert;
+  /// Root of the tree, NULL if it is empty
+  StatusQueueNode *root;
+
+  /// Pool the nodes of the tree are allocated from
+  NodePool<StatusQueueNode> *pool;
+
+  /// Leaf of each segment ID, NULL for segments not in the tree
+  vector<StatusQueueNode *> leaves;
+
+  vector<unsigned int> sorted;     //!< Scratch buffer of reorder() for the new order
+  vector<StatusQueueNode *> run;   //!< Scratch buffer of reorder() for the leaves
+  vector<StatusQueueNode *> keyed; //!< Scratch buffer of reorder() for the inner nodes keyed by them
+
+  /// Order of the segments at the current event point
+  SweepOrder *order;
+
+  /// Update and rotation counters, updated when compiled with SWEEP_STATS
+  SweepStats stats;
 
   /// Basic constructor
-  StatusQueue()
+  /// @param nodePool Pool owning the nodes of this tree
+  /// @param sweepOrder Order of the segments at the current event point
+  StatusQueue(NodePool<StatusQueueNode> *nodePool, SweepOrder *sweepOrder)
   {
-    globalinsert = 0;
+    root = NULL;
+    pool = nodePool;
+    order = sweepOrder;
+  }
+
+  /// Prepare the tree for segment IDs in the range [0, n)
+  void reserveSegments(size_t n)
+  {
+    leaves.assign(n, (StatusQueueNode *)NULL);
+  }
+
+  /// Drop all nodes without releasing them
+  ///
+  /// Used when the pool is reset in bulk.
+  void clear()
+  {
+    root = NULL;
+    leaves.assign(leaves.size(), (StatusQueueNode *)NULL);
   }
 
   /// Find height of a node in the tree
@@ -56,33 +462,62 @@ public:
     return N->height;
   }
 
+  /// Height of the whole tree
+  int height()
+  {
+    return height(root);
+  }
+
   /// Return the maximum of two integers a, b
   int max(int a, int b)
   {
     return (a > b) ? a : b;
   }
 
-  /// Create a new node
-  /// @param newl Line segment to be used as key
-  StatusQueueNode *newstatus(LineSegment newl)
+  /// Create a new leaf
+  /// @param newl ID of the line segment to be used as key
+  StatusQueueNode *newstatus(unsigned int newl)
   {
-    StatusQueueNode *node = new StatusQueueNode;
+    StatusQueueNode *node = pool->allocate();
     node->l = newl;
     node->left = NULL;
     node->right = NULL;
+    node->parent = NULL;
+    node->prev = NULL;
+    node->next = NULL;
     node->height = 1;
     return (node);
   }
 
+  /// Put a node in the place of another one under its parent
+  void replaceChild(StatusQueueNode *old, StatusQueueNode *node)
+  {
+    StatusQueueNode *p = old->parent;
+    node->parent = p;
+    if (p == NULL)
+      root = node;
+    else if (p->left == old)
+      p->left = node;
+    else
+      p->right = node;
+  }
+
 
   /// Right rotate about a point in the tree to rebalance
+  ///
+  /// The key of an inner node is the rightmost leaf of its left subtree,
+  /// which rotations leave unchanged.
   StatusQueueNode *rightRotate(StatusQueueNode *y)
   {
+    SWEEP_COUNT(stats, statusRotations);
     StatusQueueNode *x = y->left;
     StatusQueueNode *T2 = x->right;
 
+    replaceChild(y, x);
     x->right = y;
+    y->parent = x;
     y->left = T2;
+    T2->parent = y;
 
     y->height = max(height(y->left), height(y->right)) + 1;
     x->height = max(height(x->left), height(x->right)) + 1;
@@ -94,11 +529,15 @@ public:
   /// Left rotate about a point in the tree to rebalance
   StatusQueueNode *leftRotate(StatusQueueNode *x)
   {
+    SWEEP_COUNT(stats, statusRotations);
     StatusQueueNode *y = x->right;
     StatusQueueNode *T2 = y->left;
 
+    replaceChild(x, y);
     y->left = x;
+    x->parent = y;
     x->right = T2;
+    T2->parent = x;
 
     x->height = max(height(x->left), height(x->right)) + 1;
     y->height = max(height(y->left), height(y->right)) + 1;
@@ -106,15 +545,6 @@ public:
   }
 
 
-  /// Find x co-ordinate of a point on the line given the two end points and y co-ordinate
-  /// @param l Line segment on which the point lies
-  /// @param y Y-coordinate of the point
-  double findx(LineSegment l, double y)
-  {
-    return ((y - l.endY) * ((l.endX - l.startX) / (l.endY - l.startY))) + l.endX;
-  }
-
-
   /// Get balance factor of a node
   /// 
   /// Equal to height of left subtree - height of right subtree
@@ -126,71 +556,124 @@ public:
   }
 
 
-  /// Insert a new line into the status queue.
-  /// @param node Pointer to root node
-  /// @param newl New line segment to be inserted
-  /// @param ycor Current Y-coordinate of the sweep line
-  StatusQueueNode *insert(StatusQueueNode *node, LineSegment newl, double ycor)
+  /// Update the height of a node and restore its balance
+  /// @returns Pointer to the root of the rebalanced subtree
+  StatusQueueNode *rebalance(StatusQueueNode *node)
   {
-    int *justinserted = &globalinsert;
+    node->height = 1 + max(height(node->left),
+                           height(node->right));
 
-    if (node == NULL)
-    {
-      *justinserted = 1;
-      return (newstatus(newl));
-    }
+    int balance = getBalance(node);
+
+    if (balance > 1 && getBalance(node->left) >= 0)
+      return rightRotate(node);
 
-    if (findx(newl, ycor) < findx(node->l, ycor))
+    if (balance > 1 && getBalance(node->left) < 0)
     {
-      node->left = insert(node->left, newl, ycor);
-      if (*justinserted == 1)
-      {
-        node->right = newstatus(node->l);
-        node->l = newl;
-        *justinserted = 0;
-      }
+      leftRotate(node->left);
+      return rightRotate(node);
     }
-    else if (findx(newl, ycor) > findx(node->l, ycor))
+
+    if (balance < -1 && getBalance(node->right) <= 0)
+      return leftRotate(node);
+
+    if (balance < -1 && getBalance(node->right) > 0)
     {
-      // printf("Going right\n");
-      node->right = insert(node->right, newl, ycor);
-      if (*justinserted == 1)
-      {
-        // printf("copying to left leaf\n");
-        node->left = newstatus(node->l);
-        *justinserted = 0;
-      }
+      rightRotate(node->right);
+      return leftRotate(node);
     }
-    else
+
+    return node;
+  }
+
+  /// Rebalance the ancestors of a changed subtree, bottom up
+  ///
+  /// Stops at the first subtree whose height did not change.
+  /// @param node Lowest node whose subtree changed
+  void retrace(StatusQueueNode *node)
+  {
+    while (node != NULL)
     {
-      return node;
+      int old = node->height;
+      node = rebalance(node);
+      if (node->height == old)
+        return;
+      node = node->parent;
     }
-    node->height = 1 + max(height(node->left),
-                           height(node->right));
+  }
 
-    int balance = getBalance(node);
-    if (balance > 1 && findx(newl, ycor) < findx(node->left->l, ycor))
-      return rightRotate(node);
 
-    if (balance < -1 && findx(newl, ycor) > findx(node->right->l, ycor))
-      return leftRotate(node);
+  /// Find the first leaf not left of a segment just below the event point, or the last leaf if there is none
+  /// @param c Receives the position of l relative to the leaf
+  StatusQueueNode *findLeaf(unsigned int l, int &c)
+  {
+    StatusQueueNode *node = root;
+    while (node->height > 1)
+      node = (order->compareBelow(l, node->l) <= 0) ? node->left : node->right;
+    c = order->compareBelow(l, node->l);
+    return node;
+  }
+
+  /// Find the first leaf not left of the event point, or the last leaf if there is none
+  /// @param s Receives the position of the point relative to the leaf
+  StatusQueueNode *firstNotLeft(int &s)
+  {
+    StatusQueueNode *node = root;
+    while (node->height > 1)
+      node = (order->side(node->l) > 0) ? node->right : node->left;
+    s = order->side(node->l);
+    return node;
+  }
+
 
-    if (balance > 1 && findx(newl, ycor) > findx(node->left->l, ycor))
+  /// Insert a new line into the status queue at its position just below the event point.
+  ///
+  /// The leaf found takes a new inner node as parent, with the new leaf as
+  /// its other child.
+  /// @param newl ID of the new line segment to be inserted
+  void insert(unsigned int newl)
+  {
+    if (leaves[newl] != NULL)
+      return;
+    SWEEP_COUNT(stats, statusInserts);
+    if (root == NULL)
     {
-      node->left = leftRotate(node->left);
-      return rightRotate(node);
+      root = leaves[newl] = newstatus(newl);
+      return;
     }
-    if (balance < -1 && findx(newl, ycor) < findx(node->right->l, ycor))
+
+    int c;
+    StatusQueueNode *leaf = findLeaf(newl, c);
+    StatusQueueNode *node = leaves[newl] = newstatus(newl);
+    StatusQueueNode *inner = newstatus(newl);
+    replaceChild(leaf, inner);
+    inner->height = 2;
+    if (c < 0)
     {
-      node->right = rightRotate(node->right);
-      return leftRotate(node);
+      inner->left = node;
+      inner->right = leaf;
+      node->prev = leaf->prev;
+      node->next = leaf;
     }
-
-    return node;
+    else
+    {
+      inner->left = leaf;
+      inner->right = node;
+      inner->l = leaf->l;
+      node->prev = leaf;
+      node->next = leaf->next;
+    }
+    node->parent = inner;
+    leaf->parent = inner;
+    if (node->prev != NULL)
+      node->prev->next = node;
+    if (node->next != NULL)
+      node->next->prev = node;
+    retrace(inner->parent);
   }
 
 
-  /// Find the node with the min value for bst deletion
+  /// Find the node with the min value, the leftmost leaf of a subtree
   /// @returns Pointer to the minimum value node
   StatusQueueNode *minValueNode(StatusQueueNode *node)
   {
@@ -202,186 +685,178 @@ public:
     return current;
   }
 
-
-  /// Delete a line segment
-  /// @param root Pointer to root node
-  /// @param newl Line segment to be deleted
-  /// @param ycor Current Y-coordinate of the sweep line
-  StatusQueueNode *deleteNode(StatusQueueNode *root, LineSegment newl, double ycor)
+  /// Find the node with the max value, the rightmost leaf of a subtree
+  StatusQueueNode *maxValueNode(StatusQueueNode *node)
   {
+    StatusQueueNode *current = node;
 
-    if (root == NULL)
-      return root;
+    while (current->right != NULL)
+      current = current->right;
 
-    if (findx(newl, ycor) < findx(root->l, ycor))
-      root->left = deleteNode(root->left, newl, ycor);
+    return current;
+  }
 
-    else if (findx(newl, ycor) > findx(root->l, ycor))
-      root->right = deleteNode(root->right, newl, ycor);
 
-    else
+  /// Delete a line segment passing through the event point
+  ///
+  /// The leaf goes and its parent is replaced by the sibling. Segments not
+  /// in the tree are ignored.
+  /// @param newl ID of the line segment to be deleted
+  void deleteNode(unsigned int newl)
+  {
+    StatusQueueNode *leaf = leaves[newl];
+    if (leaf == NULL)
+      return;
+    SWEEP_COUNT(stats, statusDeletes);
+    leaves[newl] = NULL;
+
+    if (leaf->prev != NULL)
+      leaf->prev->next = leaf->next;
+    if (leaf->next != NULL)
+      leaf->next->prev = leaf->prev;
+    StatusQueueNode *parent = leaf->parent;
+    if (parent == NULL)
     {
-      // node with only one child or no child
-      if ((root->left == NULL) || (root->right == NULL))
-      {
-        StatusQueueNode *temp = root->left ? root->left : root->right;
-
-        if (temp == NULL)
-        {
-          temp = root;
-          root = NULL;
-        }
-        else
-          *root = *temp;
-        free(temp);
-      }
-      else
-      {
-
-        StatusQueueNode *temp = minValueNode(root->right);
-
-        // Copy the inorder successor's data to this node
-        root->l = temp->l;
-        // Delete the inorder successor
-        root->right = deleteNode(root->right, temp->l, ycor);
-      }
+      root = NULL;
+      pool->release(leaf);
+      return;
     }
 
-    if (root == NULL)
-      return root;
-
-    root->height = 1 + max(height(root->left),
-                           height(root->right));
+    // an ancestor keyed by the leaf has it as the rightmost of its left subtree
+    for (StatusQueueNode *a = parent->parent; a != NULL; a = a->parent)
+    {
+      if (a->l == newl)
+        a->l = leaf->prev->l;
+    }
+    StatusQueueNode *sibling = (parent->left == leaf) ? parent->right : parent->left;
+    replaceChild(parent, sibling);
+    retrace(sibling->parent);
+    pool->release(leaf);
+    pool->release(parent);
+  }
 
-    int balance = getBalance(root);
 
-    if (balance > 1 && getBalance(root->left) >= 0)
-      return rightRotate(root);
+  /// Inner node whose key is a leaf, the one with the leaf rightmost in its left subtree
+  /// @returns NULL for the rightmost leaf of the tree
+  StatusQueueNode *keyedBy(StatusQueueNode *leaf)
+  {
+    StatusQueueNode *node = leaf;
+    while (node->parent != NULL && node->parent->right == node)
+      node = node->parent;
+    return node->parent;
+  }
 
-    if (balance > 1 && getBalance(root->left) < 0)
+  /// Move the segments through the event point to their order just below it
+  ///
+  /// They must be all the segments of the tree through the point, so their
+  /// leaves form one run. The leaves stay where they are and only the IDs
+  /// they hold are sorted, which needs no rebalancing.
+  /// @param ids The segments, left to right as containing() returns them
+  void reorder(const vector<unsigned int> &ids)
+  {
+    if (ids.size() < 2)
+      return;
+    SWEEP_ADD(stats, statusReorders, ids.size());
+    run.resize(ids.size());
+    keyed.resize(ids.size());
+    for (size_t i = 0; i < ids.size(); i++)
     {
-      root->left = leftRotate(root->left);
-      return rightRotate(root);
+      run[i] = leaves[ids[i]];
+      keyed[i] = keyedBy(run[i]);
     }
 
-    if (balance < -1 && getBalance(root->right) <= 0)
-      return leftRotate(root);
-
-    if (balance < -1 && getBalance(root->right) > 0)
+    sorted.assign(ids.begin(), ids.end());
+    SweepOrder *o = order;
+    sort(sorted.begin(), sorted.end(), [o](unsigned int s, unsigned int t) { return o->compareBelow(s, t) < 0; });
+    for (size_t i = 0; i < sorted.size(); i++)
     {
-      root->right = rightRotate(root->right);
-      return leftRotate(root);
+      run[i]->l = sorted[i];
+      leaves[sorted[i]] = run[i];
+      if (keyed[i] != NULL)
+        keyed[i]->l = sorted[i];
     }
-
-    return root;
   }
 
 
   /// Print preorder of current tree
-  void preOrder(StatusQueueNode *root)
+  void preOrder(StatusQueueNode *node)
   {
-    if (root != NULL)
+    if (node != NULL)
     {
-      //printf("%f %f %f %f %d\n", root->l.startX, root->l.startY, root->l.endX, root->l.endY, root->height);
-      cout << root->l.startX << " " << root->l.startY << " "
-      << root->l.endX << " " << root->l.endY << " " << root->height << "\n";
-      preOrder(root->left);
-      preOrder(root->right);
+      const LineSegment &l = (*order->segments)[node->l];
+      cout << node->l << ": " << l.startX << " " << l.startY << " "
+      << l.endX << " " << l.endY << " " << node->height << "\n";
+      preOrder(node->left);
+      preOrder(node->right);
     }
   }
 
   /// Get the left neighbor of a particular line segment from the status queue
-  void getLeftNeighbor(StatusQueueNode *node, LineSegment l, double ycor, struct LineSegment *lastRight)
+  ///
+  /// lastRight stays NO_SEGMENT if there is no neighbor
+  void getLeftNeighbor(unsigned int l, unsigned int *lastRight)
   {
-    if (node->height == 1)
-    {
-      if (lastRight->startX == -1)
-      {
-        if (findx(node->l, ycor - 0.1) < findx(l, ycor - 0.1))
-        {
-          *lastRight = node->l;
-        }
-      }
+    if (root == NULL)
       return;
-    }
-    if ((findx(l, ycor - 0.1) - 0.1) < findx(node->l, ycor - 0.1))
-    {
-      getLeftNeighbor(node->left, l, ycor, lastRight);
-    }
-    else if ((findx(l, ycor - 0.1) - 0.1) > findx(node->l, ycor - 0.1))
-    {
-      *lastRight = node->l;
-      getLeftNeighbor(node->right, l, ycor, lastRight);
-    }
+    int c = 0;
+    StatusQueueNode *leaf = (leaves[l] != NULL) ? leaves[l] : findLeaf(l, c);
+    if (c > 0)
+      *lastRight = leaf->l;
+    else if (leaf->prev != NULL)
+      *lastRight = leaf->prev->l;
   }
 
   /// Get the right neighbor of a particular line segment from the status queue
-  void getRightNeighbor(StatusQueueNode *node, LineSegment l, double ycor, struct LineSegment *lastLeft)
+  ///
+  /// lastLeft stays NO_SEGMENT if there is no neighbor
+  void getRightNeighbor(unsigned int l, unsigned int *lastLeft)
   {
-    if (node->height == 1)
-    {
-      if (lastLeft->startX == -1)
-      {
-        if (findx(node->l, ycor - 0.1) > findx(l, ycor - 0.1))
-        {
-          *lastLeft = node->l;
-        }
-      }
+    if (root == NULL)
       return;
-    }
-    if ((findx(l, ycor - 0.1) + 0.1) < findx(node->l, ycor - 0.1))
-    {
-      *lastLeft = node->l;
-      getRightNeighbor(node->left, l, ycor, lastLeft);
-    }
-    else if ((findx(l, ycor - 0.1) + 0.1) > findx(node->l, ycor - 0.1))
-    {
-      getRightNeighbor(node->right, l, ycor, lastLeft);
-    }
+    int c = 0;
+    StatusQueueNode *leaf = (leaves[l] != NULL) ? leaves[l] : findLeaf(l, c);
+    if (c < 0)
+      *lastLeft = leaf->l;
+    else if (leaf->next != NULL)
+      *lastLeft = leaf->next->l;
   }
 
-  /// Get left and right neighbouring segments of a point
+  /// Get left and right neighbouring segments of the event point
   ///
-  /// lastLeft is the right neighbour and lastRight is the left neighbour for the point
-  void getNeighbors(StatusQueueNode *node, double xcor, double ycor, struct LineSegment *lastRight, struct LineSegment *lastLeft)
+  /// No segment in the tree may pass through the point. lastLeft is the
+  /// right neighbour and lastRight is the left neighbour for the point;
+  /// both stay NO_SEGMENT if there is no such neighbour.
+  void getNeighbors(unsigned int *lastRight, unsigned int *lastLeft)
   {
-    if (node->height == 1)
-    {
-      if (lastRight->startX == -1)
-      {
-        if (findx(node->l, ycor - 0.1) <= xcor)
-        {
-          *lastRight = node->l;
-        }
-      }
-      if (lastLeft->startX == -1)
-      {
-        if (findx(node->l, ycor - 0.1) > xcor)
-        {
-          *lastLeft = node->l;
-        }
-      }
+    if (root == NULL)
       return;
-    }
-
-    if (xcor < findx(node->l, ycor - 0.1))
+    int s;
+    StatusQueueNode *leaf = firstNotLeft(s);
+    if (s > 0)
+      *lastRight = leaf->l;
+    else
     {
-      // printf("go left");
-      *lastLeft = node->l;
-      getNeighbors(node->left, xcor, ycor, lastRight, lastLeft);
+      *lastLeft = leaf->l;
+      if (leaf->prev != NULL)
+        *lastRight = leaf->prev->l;
     }
-    else if (xcor > findx(node->l, ycor - 0.1))
-    {
-      // printf("go right");
-      *lastRight = node->l;
-      if (node->right == NULL)
-      {
-        return;
-      }
+  }
 
-      getNeighbors(node->right, xcor, ycor, lastRight, lastLeft);
+  /// Collect the segments passing through the event point, left to right
+  /// @param out Receives the IDs, appended
+  void containing(vector<unsigned int> &out)
+  {
+    if (root == NULL)
+      return;
+    int s;
+    for (StatusQueueNode *leaf = firstNotLeft(s); leaf != NULL && s == 0;)
+    {
+      out.push_back(leaf->l);
+      leaf = leaf->next;
+      if (leaf != NULL)
+        s = order->side(leaf->l);
     }
   }
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,91 @@
+#ifndef SWEEP_STATS_H
+#define SWEEP_STATS_H
+
+#include <stddef.h>
+
+/// Counters describing the work done by one run of the sweep.
+///
+/// The counters are only updated when the code is compiled with
+/// -DSWEEP_STATS; otherwise every counting macro expands to nothing and all
+/// fields stay zero. FindIntersections::stats() gathers them after
+/// runAlgorithm.
+struct SweepStats
+{
+  unsigned long long events;           //!< Event points popped from the event queue
+  unsigned long long eventInserts;     //!< Event points created, including the bulk loaded endpoints
+  unsigned long long eventMerges;      //!< Inserts that landed on an event point already queued
+  unsigned long long eventDeletes;     //!< Event points removed from the event queue
+  unsigned long long eventRotations;   //!< Rotations of the event queue tree
+  unsigned long long statusInserts;    //!< Segments inserted into the status queue
+  unsigned long long statusDeletes;    //!< Segments deleted from the status queue
+  unsigned long long statusReorders;   //!< Segments reordered in place at intersection events
+  unsigned long long statusRotations;  //!< Rotations of the status queue tree
+  unsigned long long statusShifts;     //!< Entries moved by the gap of the flat status queue
+  unsigned long long comparisons;      //!< Exact order predicates evaluated against the sweep line
+  unsigned long long neighborLookups;  //!< Neighbour queries on the status queue
+  unsigned long long findNewEvents;    //!< Calls to findNewEvent
+  unsigned long long newEvents;        //!< findNewEvent calls that created an event point
+  unsigned long long duplicateEvents;  //!< findNewEvent calls whose point was already queued
+  size_t maxEventQueueSize;            //!< Largest number of event points queued at once
+  size_t maxEventHeight;               //!< Largest height of the event queue tree or heap
+  size_t maxStatusSize;                //!< Largest number of segments in the status queue
+  size_t maxStatusHeight;              //!< Largest height of the status queue tree
+
+  SweepStats()
+  {
+    clear();
+  }
+
+  /// Reset every counter to zero
+  void clear()
+  {
+    events = eventInserts = eventMerges = eventDeletes = eventRotations = 0;
+    statusInserts = statusDeletes = statusReorders = statusRotations = statusShifts = comparisons = 0;
+    neighborLookups = findNewEvents = newEvents = duplicateEvents = 0;
+    maxEventQueueSize = maxEventHeight = maxStatusSize = maxStatusHeight = 0;
+  }
+
+  /// Add the counters of another run or data structure
+  void merge(const SweepStats &o)
+  {
+    events += o.events;
+    eventInserts += o.eventInserts;
+    eventMerges += o.eventMerges;
+    eventDeletes += o.eventDeletes;
+    eventRotations += o.eventRotations;
+    statusInserts += o.statusInserts;
+    statusDeletes += o.statusDeletes;
+    statusReorders += o.statusReorders;
+    statusRotations += o.statusRotations;
+    statusShifts += o.statusShifts;
+    comparisons += o.comparisons;
+    neighborLookups += o.neighborLookups;
+    findNewEvents += o.findNewEvents;
+    newEvents += o.newEvents;
+    duplicateEvents += o.duplicateEvents;
+    if (o.maxEventQueueSize > maxEventQueueSize)
+      maxEventQueueSize = o.maxEventQueueSize;
+    if (o.maxEventHeight > maxEventHeight)
+      maxEventHeight = o.maxEventHeight;
+    if (o.maxStatusSize > maxStatusSize)
+      maxStatusSize = o.maxStatusSize;
+    if (o.maxStatusHeight > maxStatusHeight)
+      maxStatusHeight = o.maxStatusHeight;
+  }
+};
+
+#ifdef SWEEP_STATS
+/// Add n to a counter of a SweepStats
+#define SWEEP_ADD(stats, field, n) ((stats).field += (n))
+/// Raise a maximum of a SweepStats to value
+#define SWEEP_MAX(stats, field, value) \
+  do { if ((size_t)(value) > (stats).field) (stats).field = (size_t)(value); } while (0)
+#else
+#define SWEEP_ADD(stats, field, n) ((void)0)
+#define SWEEP_MAX(stats, field, value) ((void)0)
+#endif
+
+/// Increment a counter of a SweepStats
+#define SWEEP_COUNT(stats, field) SWEEP_ADD(stats, field, 1)
+
+#endif
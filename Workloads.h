@@ -0,0 +1,215 @@
+#ifndef WORKLOADS_H
+#define WORKLOADS_H
+
+#include <math.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "StatusQueue.h"
+using namespace std;
+
+/// Reproducible synthetic inputs for benchmarking the intersection engines.
+///
+/// Every generator fills the square [0, 1000] x [0, 1000] with n segments and
+/// draws from its own mt19937_64 seeded with the given seed, so a workload
+/// name, n and seed always give the same segments. Segment lengths shrink
+/// with n so that the number of intersections grows roughly linearly,
+/// except where a shape makes that impossible.
+namespace workloads
+{
+
+const double SIDE = 1000.0;  //!< Side of the square holding the segments
+
+/// Add the segment from (x1, y1) to (x2, y2)
+inline void add(vector<LineSegment> &out, double x1, double y1, double x2, double y2)
+{
+  LineSegment l;
+  l.startX = x1;
+  l.startY = y1;
+  l.endX = x2;
+  l.endY = y2;
+  out.push_back(l);
+}
+
+/// Segments with uniformly random centres and directions
+inline vector<LineSegment> uniform(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  uniform_real_distribution<double> pos(0, SIDE), angle(0, M_PI);
+  double length = 2 * SIDE / sqrt((double)max(n, (size_t)1));
+  vector<LineSegment> out;
+  out.reserve(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    double cx = pos(rng), cy = pos(rng), a = angle(rng);
+    double dx = cos(a) * length / 2, dy = sin(a) * length / 2;
+    add(out, cx - dx, cy - dy, cx + dx, cy + dy);
+  }
+  return out;
+}
+
+/// Long thin polylines, like roads on a map
+///
+/// Each road is a random walk of short pieces that keeps its heading within
+/// a few degrees, so consecutive pieces share an endpoint and roads cross
+/// each other at shallow and steep angles alike.
+inline vector<LineSegment> roads(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  uniform_real_distribution<double> pos(0, SIDE), angle(0, 2 * M_PI), turn(-0.05, 0.05);
+  const size_t piecesPerRoad = 64;
+  double step = 4 * SIDE / sqrt((double)max(n, (size_t)1)) / 8;
+  vector<LineSegment> out;
+  out.reserve(n);
+  while (out.size() < n)
+  {
+    double x = pos(rng), y = pos(rng), heading = angle(rng);
+    for (size_t k = 0; k < piecesPerRoad && out.size() < n; k++)
+    {
+      heading += turn(rng);
+      double nx = x + cos(heading) * step, ny = y + sin(heading) * step;
+      add(out, x, y, nx, ny);
+      x = nx;
+      y = ny;
+    }
+  }
+  return out;
+}
+
+/// Axis-parallel lattice of horizontal and vertical segments
+///
+/// Every segment spans four lattice cells and starts on a lattice point, so
+/// many intersections and endpoints coincide exactly. The pitch is a power
+/// of two, so the lattice fills between half and all of the square and a
+/// power of two scaling puts it on the integer grid.
+inline vector<LineSegment> grid(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  size_t cells = (size_t)sqrt((double)max(n, (size_t)1)) + 4;
+  uniform_int_distribution<size_t> cell(0, cells - 4);
+  double pitch = exp2(floor(log2(SIDE / cells)));
+  vector<LineSegment> out;
+  out.reserve(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    double u = cell(rng) * pitch, v = cell(rng) * pitch;
+    if (i % 2 == 0)
+      add(out, u, v, u + 4 * pitch, v);
+    else
+      add(out, u, v, u, v + 4 * pitch);
+  }
+  return out;
+}
+
+/// Segments lying on a few shared lines, overlapping each other
+///
+/// Every line has an integer origin and a small integer direction, and the
+/// endpoints are integer multiples of a power of two step along it. All
+/// coordinates are exact doubles, so the segments of a line really are
+/// collinear.
+inline vector<LineSegment> collinear(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  uniform_int_distribution<int> slope(-8, 8), rise(1, 8), height(-(int)SIDE / 4, (int)SIDE / 4);
+  const size_t lines = 16;
+  vector<double> ox(lines), oy(lines), dx(lines), dy(lines);
+  for (size_t k = 0; k < lines; k++)
+  {
+    ox[k] = SIDE / 2;
+    oy[k] = SIDE / 2 + height(rng);
+    dx[k] = slope(rng);
+    dy[k] = rise(rng);
+  }
+  double length = SIDE / 4 / sqrt((double)max(n, (size_t)1));
+  vector<LineSegment> out;
+  out.reserve(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t k = i % lines;
+    // about eight to sixteen steps per segment
+    double norm = sqrt(dx[k] * dx[k] + dy[k] * dy[k]);
+    double step = exp2(floor(log2(length / norm / 8)));
+    long long steps = (long long)(length / (norm * step)), reach = (long long)(SIDE / 4 / (norm * step));
+    long long t = uniform_int_distribution<long long>(-reach, reach - steps)(rng);
+    add(out, ox[k] + dx[k] * (t * step), oy[k] + dy[k] * (t * step),
+        ox[k] + dx[k] * ((t + steps) * step), oy[k] + dy[k] * ((t + steps) * step));
+  }
+  return out;
+}
+
+/// Bursts of segments that all pass through the centre of their burst
+///
+/// Each burst puts 16 segments through one point, giving events where many
+/// segments meet at once.
+inline vector<LineSegment> star(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  uniform_real_distribution<double> pos(0, SIDE), angle(0, M_PI);
+  const size_t raysPerBurst = 16;
+  double length = 2 * SIDE / sqrt((double)max(n, (size_t)1));
+  vector<LineSegment> out;
+  out.reserve(n);
+  while (out.size() < n)
+  {
+    double cx = pos(rng), cy = pos(rng);
+    for (size_t k = 0; k < raysPerBurst && out.size() < n; k++)
+    {
+      double a = angle(rng);
+      double dx = cos(a) * length / 2, dy = sin(a) * length / 2;
+      add(out, cx - dx, cy - dy, cx + dx, cy + dy);
+    }
+  }
+  return out;
+}
+
+/// Long segments with almost the same direction
+///
+/// Few pairs cross, but every segment stays in the status structure for most
+/// of the sweep and neighbours are hard to tell apart. The spread of the
+/// slopes shrinks with n to keep the crossings linear.
+inline vector<LineSegment> nearParallel(size_t n, unsigned long long seed)
+{
+  mt19937_64 rng(seed);
+  double spread = 1.0 / max(n, (size_t)1);
+  uniform_real_distribution<double> pos(0, SIDE), jitter(-spread, spread);
+  vector<LineSegment> out;
+  out.reserve(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    double x = pos(rng), slope = 0.2 + jitter(rng);
+    add(out, x, 0, x + slope * SIDE, SIDE);
+  }
+  return out;
+}
+
+/// Names of all workloads, in the order they are benchmarked
+inline vector<string> names()
+{
+  const char *all[] = {"uniform", "roads", "grid", "collinear", "star", "near-parallel"};
+  return vector<string>(all, all + 6);
+}
+
+/// Generate a workload by name
+/// @returns false if there is no workload with that name
+inline bool generate(const string &name, size_t n, unsigned long long seed, vector<LineSegment> &out)
+{
+  if (name == "uniform")
+    out = uniform(n, seed);
+  else if (name == "roads")
+    out = roads(n, seed);
+  else if (name == "grid")
+    out = grid(n, seed);
+  else if (name == "collinear")
+    out = collinear(n, seed);
+  else if (name == "star")
+    out = star(n, seed);
+  else if (name == "near-parallel")
+    out = nearParallel(n, seed);
+  else
+    return false;
+  return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,419 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include "FindIntersections.h"
+#include "SlabIntersections.h"
+#include "Workloads.h"
+
+// Benchmark of FindIntersections on synthetic workloads.
+//
+// For every workload, size and engine the benchmark times the constructor
+// (which builds the event queue), runAlgorithm and runAlgorithmB. Each case
+// is repeated until it has run for at least --min-time seconds and the mean
+// is reported, in the spirit of Google Benchmark:
+//
+//     benchmark --workloads uniform,grid --sizes 1000,100000 --engines flat-heap
+//
+// Engines ending in -int sweep with the integer coordinate engine. They run
+// on workloads that a power of two scaling puts on the integer grid, such as
+// grid and collinear, and their records are scaled back, which is exact.
+// The brute force is quadratic and only runs up to --brute-max segments.
+// With --check, every engine and the slab engine are also compared with the
+// brute force wherever it runs, which covers the degenerate workloads.
+
+/// Settings of one benchmark run
+struct BenchmarkOptions
+{
+    vector<string> workloads = workloads::names();
+    vector<size_t> sizes = {100, 1000, 10000, 100000, 1000000, 10000000};
+    vector<string> engines = {"avl-avl", "avl-heap", "flat-avl", "flat-heap", "avl-heap-int"};
+    size_t bruteMax = 20000;
+    double minTime = 0.5;
+    unsigned long long seed = 1;
+    unsigned int threads = 0;
+    bool check = false;
+    unsigned int slabs = 4;
+};
+
+/// Mean time of one case
+struct Measurement
+{
+    double seconds = 0;         //!< Mean wall time of one iteration
+    size_t iterations = 0;      //!< Number of iterations run
+    size_t intersections = 0;   //!< Intersecting pairs reported by the last iteration
+};
+
+/// Split a comma separated list
+vector<string> split(const char *list)
+{
+    vector<string> items;
+    stringstream in(list);
+    string item;
+    while (getline(in, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+/// Parse an engine name such as flat-heap or avl-heap-int
+bool parseEngine(const string &name, StatusEngine &status, EventEngine &events, CoordinateEngine &coordinates)
+{
+    vector<string> parts;
+    stringstream in(name);
+    string part;
+    while (getline(in, part, '-'))
+        parts.push_back(part);
+    if (parts.size() < 2 || parts.size() > 3)
+        return false;
+    string s = parts[0], e = parts[1], c = (parts.size() == 3) ? parts[2] : "double";
+    if ((s != "avl" && s != "flat") || (e != "avl" && e != "heap") || (c != "double" && c != "int"))
+        return false;
+    status = (s == "flat") ? FLAT_STATUS : AVL_STATUS;
+    events = (e == "heap") ? HEAP_EVENTS : AVL_EVENTS;
+    coordinates = (c == "int") ? INTEGER_COORDINATES : DOUBLE_COORDINATES;
+    return true;
+}
+
+/// Smallest power of two that puts every coordinate on the grid of the integer engine
+/// @returns 0 if there is none
+double integerScale(const vector<LineSegment> &segments)
+{
+    double scale = 1;
+    for (size_t i = 0; i < segments.size() && scale < INTEGER_COORDINATE_LIMIT; i++)
+    {
+        const double v[4] = {segments[i].startX, segments[i].startY, segments[i].endX, segments[i].endY};
+        for (int k = 0; k < 4; k++)
+        {
+            while (scale < INTEGER_COORDINATE_LIMIT && v[k] * scale != floor(v[k] * scale))
+                scale *= 2;
+        }
+    }
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        const LineSegment &l = segments[i];
+        if (!integerCoordinate(l.startX * scale) || !integerCoordinate(l.startY * scale) ||
+            !integerCoordinate(l.endX * scale) || !integerCoordinate(l.endY * scale))
+            return 0;
+    }
+    return scale;
+}
+
+/// Multiply every coordinate by a power of two, which is exact
+void scaleSegments(const vector<LineSegment> &segments, double scale, vector<LineSegment> &scaled)
+{
+    scaled.resize(segments.size());
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        scaled[i].startX = segments[i].startX * scale;
+        scaled[i].startY = segments[i].startY * scale;
+        scaled[i].endX = segments[i].endX * scale;
+        scaled[i].endY = segments[i].endY * scale;
+    }
+}
+
+/// Seconds elapsed since a time point
+double since(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/// Time the constructor and runAlgorithm of one engine
+/// @param intersections Receives the records of the last iteration
+void benchmarkSweep(vector<LineSegment> &segments, const BenchmarkOptions &options, StatusEngine status,
+                    EventEngine events, CoordinateEngine coordinates, Measurement &build, Measurement &sweep,
+                    vector<IntersectionRecord> &intersections)
+{
+    double buildTotal = 0, sweepTotal = 0;
+    size_t iterations = 0;
+    while (iterations == 0 || buildTotal + sweepTotal < options.minTime)
+    {
+        intersections.clear();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        unique_ptr<FindIntersections> findIntersection(
+            new FindIntersections(segments, status, events, options.threads, coordinates));
+        buildTotal += since(start);
+
+        start = chrono::steady_clock::now();
+        findIntersection->runAlgorithm(intersections);
+        sweepTotal += since(start);
+        iterations++;
+    }
+    build.seconds = buildTotal / iterations;
+    build.iterations = iterations;
+    sweep.seconds = sweepTotal / iterations;
+    sweep.iterations = iterations;
+    sweep.intersections = intersections.size();
+}
+
+/// Time runAlgorithmB
+/// @param intersections Receives the records of the last iteration
+void benchmarkBrute(vector<LineSegment> &segments, const BenchmarkOptions &options, Measurement &brute,
+                    vector<IntersectionRecord> &intersections)
+{
+    vector<LineSegment> none;
+    FindIntersections findIntersection(none);
+    double total = 0;
+    size_t iterations = 0;
+    while (iterations == 0 || total < options.minTime)
+    {
+        intersections.clear();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        findIntersection.runAlgorithmB(segments, intersections, options.threads);
+        total += since(start);
+        iterations++;
+    }
+    brute.seconds = total / iterations;
+    brute.iterations = iterations;
+    brute.intersections = intersections.size();
+}
+
+/// Sort records by point and pair, so results in different orders compare equal
+void canonical(vector<IntersectionRecord> &records)
+{
+    sort(records.begin(), records.end(), [](const IntersectionRecord &p, const IntersectionRecord &q) {
+        if (p.y != q.y)
+            return p.y > q.y;
+        if (p.x != q.x)
+            return p.x < q.x;
+        return (p.a != q.a) ? p.a < q.a : p.b < q.b;
+    });
+}
+
+/// Compare the records of an engine with the brute force and print the outcome
+/// @param expected Records of the brute force, in canonical order
+/// @returns true if they are the same
+bool checkRecords(const string &name, vector<IntersectionRecord> &found, const vector<IntersectionRecord> &expected)
+{
+    canonical(found);
+    bool same = found.size() == expected.size();
+    for (size_t i = 0; same && i < found.size(); i++)
+    {
+        same = found[i].x == expected[i].x && found[i].y == expected[i].y &&
+               found[i].a == expected[i].a && found[i].b == expected[i].b;
+    }
+    printf("%-44s %s, %zu pairs, %zu expected\n", name.c_str(), same ? "ok" : "MISMATCH", found.size(), expected.size());
+    fflush(stdout);
+    return same;
+}
+
+/// Print one row of the report
+void report(const string &name, size_t n, const Measurement &m)
+{
+    double ns = m.seconds * 1e9;
+    printf("%-44s %12.3f ms %8zu %12.1f ", name.c_str(), m.seconds * 1e3, m.iterations, ns / n);
+    if (m.intersections > 0)
+        printf("%14.1f", ns / m.intersections);
+    else
+        printf("%14s", "-");
+    if (m.intersections > 0)
+        printf(" %12zu\n", m.intersections);
+    else
+        printf(" %12s\n", "-");
+    fflush(stdout);
+}
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --workloads LIST   comma separated, default uniform,roads,grid,collinear,star,near-parallel\n"
+            "  --sizes LIST       comma separated segment counts, default 100,...,10000000\n"
+            "  --engines LIST     status-events pairs of avl/flat and avl/heap, with -int for the\n"
+            "                     integer coordinate engine, default the four pairs and avl-heap-int\n"
+            "  --brute-max N      largest size run through the brute force, default 20000\n"
+            "  --min-time S       minimum seconds per case, default 0.5\n"
+            "  --seed N           seed of the workload generators, default 1\n"
+            "  --threads N        threads for sorting and the brute force, 0 for one per core,\n"
+            "                     at most 1024\n"
+            "  --check            compare every engine with the brute force where it runs\n"
+            "  --slabs N          slabs of the slab engine compared by --check, default 4,\n"
+            "                     at most 65536\n",
+            name);
+}
+
+/// Parse a non-negative count, capping it at a maximum
+/// @returns false if the text is not a non-negative integer
+bool parseCount(const char *text, unsigned int maximum, unsigned int &count)
+{
+    if (text == NULL)
+        return false;
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0)
+        return false;
+    count = (errno == ERANGE || value > (long)maximum) ? maximum : (unsigned int)value;
+    return true;
+}
+
+/// Parse the command line
+/// @returns false if the options are invalid
+bool parseOptions(int argc, char **argv, BenchmarkOptions &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--check") == 0)
+        {
+            options.check = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+            return false;
+        string arg = argv[i];
+        const char *value = argv[++i];
+        if (arg == "--workloads")
+            options.workloads = split(value);
+        else if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            vector<string> sizes = split(value);
+            for (size_t k = 0; k < sizes.size(); k++)
+                options.sizes.push_back((size_t)atof(sizes[k].c_str()));
+        }
+        else if (arg == "--engines")
+            options.engines = split(value);
+        else if (arg == "--brute-max")
+            options.bruteMax = (size_t)atof(value);
+        else if (arg == "--min-time")
+            options.minTime = atof(value);
+        else if (arg == "--seed")
+            options.seed = strtoull(value, NULL, 10);
+        else if (arg == "--threads")
+        {
+            if (!parseCount(value, MAX_THREADS, options.threads))
+                return false;
+        }
+        else if (arg == "--slabs")
+        {
+            if (!parseCount(value, MAX_SLABS, options.slabs))
+                return false;
+        }
+        else
+            return false;
+    }
+
+    StatusEngine status;
+    EventEngine events;
+    CoordinateEngine coordinates;
+    for (size_t k = 0; k < options.engines.size(); k++)
+    {
+        if (!parseEngine(options.engines[k], status, events, coordinates))
+            return false;
+    }
+    vector<LineSegment> probe;
+    for (size_t k = 0; k < options.workloads.size(); k++)
+    {
+        if (!workloads::generate(options.workloads[k], 0, 0, probe))
+            return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BenchmarkOptions options;
+    if (!parseOptions(argc, argv, options))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%-44s %15s %8s %12s %14s %12s\n", "Benchmark", "Time", "Iters", "ns/segment", "ns/intersect", "Pairs");
+    size_t mismatches = 0;
+    for (size_t w = 0; w < options.workloads.size(); w++)
+    {
+        for (size_t s = 0; s < options.sizes.size(); s++)
+        {
+            size_t n = options.sizes[s];
+            vector<LineSegment> segments;
+            workloads::generate(options.workloads[w], n, options.seed, segments);
+            string prefix = options.workloads[w] + "/" + to_string(n) + "/";
+            bool check = options.check && n <= options.bruteMax;
+            vector<vector<IntersectionRecord> > results(options.engines.size());
+            vector<bool> ran(options.engines.size(), false);
+
+            // the integer engines sweep a copy scaled onto the integer grid
+            double scale = -1;
+            vector<LineSegment> scaled;
+
+            for (size_t e = 0; e < options.engines.size(); e++)
+            {
+                StatusEngine status;
+                EventEngine events;
+                CoordinateEngine coordinates;
+                parseEngine(options.engines[e], status, events, coordinates);
+                if (coordinates == INTEGER_COORDINATES && scale < 0)
+                {
+                    scale = integerScale(segments);
+                    if (scale > 0)
+                        scaleSegments(segments, scale, scaled);
+                }
+                if (coordinates == INTEGER_COORDINATES && scale == 0)
+                {
+                    printf("%-44s not on the integer grid\n", (prefix + "sweep/" + options.engines[e]).c_str());
+                    continue;
+                }
+
+                Measurement build, sweep;
+                benchmarkSweep((coordinates == INTEGER_COORDINATES) ? scaled : segments, options, status, events,
+                               coordinates, build, sweep, results[e]);
+                report(prefix + "build/" + options.engines[e], n, build);
+                report(prefix + "sweep/" + options.engines[e], n, sweep);
+                ran[e] = true;
+                if (!check)
+                    vector<IntersectionRecord>().swap(results[e]);
+                else if (coordinates == INTEGER_COORDINATES)
+                {
+                    for (size_t i = 0; i < results[e].size(); i++)
+                    {
+                        results[e][i].x /= scale;
+                        results[e][i].y /= scale;
+                    }
+                }
+            }
+
+            if (n <= options.bruteMax)
+            {
+                Measurement brute;
+                vector<IntersectionRecord> expected;
+                benchmarkBrute(segments, options, brute, expected);
+                report(prefix + "brute", n, brute);
+                if (!check)
+                    continue;
+
+                canonical(expected);
+                for (size_t e = 0; e < options.engines.size(); e++)
+                {
+                    if (!ran[e])
+                        continue;
+                    StatusEngine status;
+                    EventEngine events;
+                    CoordinateEngine coordinates;
+                    parseEngine(options.engines[e], status, events, coordinates);
+                    mismatches += !checkRecords(prefix + "check/" + options.engines[e], results[e], expected);
+
+                    // the slab engine sweeps with doubles only
+                    if (coordinates == INTEGER_COORDINATES)
+                        continue;
+                    vector<IntersectionRecord> slabbed;
+                    SlabIntersections slabs(segments, options.slabs, options.threads, status, events);
+                    slabs.runAlgorithm(slabbed);
+                    mismatches += !checkRecords(prefix + "check/slab-" + options.engines[e], slabbed, expected);
+                }
+            }
+        }
+    }
+    if (mismatches > 0)
+    {
+        fprintf(stderr, "%zu engines disagree with the brute force\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "SegmentFile.h"
+#include "SegmentParser.h"
+using namespace std;
+
+/// Convert a text segment file to the binary segment format.
+///
+/// The text format is the one read by main: the number of segments followed
+/// by one segment per line, x1 y1 x2 y2 separated by whitespace. Use "-"
+/// as the input to read stdin.
+///
+/// Usage: convert <input.txt> <output.swpl> [--float32]
+int main(int argc, char **argv)
+{
+    if (argc < 3 || (argc == 4 && strcmp(argv[3], "--float32") != 0) || argc > 4) {
+        fprintf(stderr, "usage: %s <input.txt> <output.swpl> [--float32]\n", argv[0]);
+        return 2;
+    }
+
+    vector<LineSegment> segmentVector;
+    string error;
+    if (!parseSegmentTextFile(argv[1], segmentVector, 0, error)) {
+        fprintf(stderr, "%s: %s\n", argv[1], error.c_str());
+        return 1;
+    }
+
+    if (!writeSegmentFile(argv[2], segmentVector, argc == 4)) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+    return 0;
+}
@@ -1,8 +1,228 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 #include "FindIntersections.h"
+#include "SegmentParser.h"
+#include "SlabIntersections.h"
 
+/// Command line options of the driver
+struct Options
+{
+    const char *algorithm = "sweep";    //!< sweep, slab or brute
+    const char *input = "-";            //!< Text or binary segment file, "-" for stdin
+    const char *output = "-";           //!< Result file, "-" for stdout
+    const char *mode = "text";          //!< text, quiet, count, any, groups or binary
+    StatusEngine status = AVL_STATUS;
+    EventEngine events = AVL_EVENTS;
+    CoordinateEngine coordinates = DOUBLE_COORDINATES;
+    unsigned int threads = 0;
+    unsigned int slabs = 0;
+    bool timing = false;
+    bool prompt = false;
+    bool help = false;
+};
 
-int main(){
-    vector<LineSegment> segmentVector;
+/// Wall clock time of the phases of one run
+class PhaseTimer
+{
+    chrono::steady_clock::time_point last = chrono::steady_clock::now();
+    bool enabled;
+
+  public:
+    PhaseTimer(bool print) : enabled(print) {}
+
+    /// Print the time since the previous phase ended
+    void lap(const char *phase)
+    {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (enabled)
+            fprintf(stderr, "%-8s %10.3f ms\n", phase, chrono::duration<double, milli>(now - last).count());
+        last = now;
+    }
+};
+
+void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -a, --algorithm NAME  sweep (default), slab or brute\n"
+            "  -i, --input FILE      text or binary segment file, - for stdin (default)\n"
+            "  -o, --output FILE     result file, - for stdout (default)\n"
+            "  -m, --mode MODE       text (default), quiet, count, any, groups or binary;\n"
+            "                        groups prints every intersection point once with\n"
+            "                        the IDs of all segments meeting there\n"
+            "  -s, --status NAME     status queue of the sweep: avl (default) or flat\n"
+            "  -e, --events NAME     event queue of the sweep: avl (default) or heap\n"
+            "  -c, --coordinates A   arithmetic of the sweep: double (default) or int,\n"
+            "                        which needs integer coordinates below 2^31\n"
+            "  -t, --threads N       worker threads, 0 for one per core (default), at most 1024\n"
+            "      --slabs N         slabs of the slab algorithm, 0 for one per thread (default),\n"
+            "                        at most 65536\n"
+            "      --timing          print the time of every phase to stderr, and the\n"
+            "                        sweep counters when built with -DSWEEP_STATS\n"
+            "      --prompt          ask for the segments interactively\n"
+            "  -h, --help            show this message\n",
+            name);
+}
+
+/// Parse a non-negative count, capping it at a maximum
+/// @returns false if the text is not a non-negative integer
+bool parseCount(const char *text, unsigned int maximum, unsigned int &count)
+{
+    if (text == NULL)
+        return false;
+    char *end;
+    errno = 0;
+    long value = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value < 0)
+        return false;
+    count = (errno == ERANGE || value > (long)maximum) ? maximum : (unsigned int)value;
+    return true;
+}
+
+/// Parse the command line
+/// @returns false if the options are invalid
+bool parseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        bool takesValue = true;
+
+        if (arg == "-a" || arg == "--algorithm")
+            options.algorithm = value;
+        else if (arg == "-i" || arg == "--input")
+            options.input = value;
+        else if (arg == "-o" || arg == "--output")
+            options.output = value;
+        else if (arg == "-m" || arg == "--mode")
+            options.mode = value;
+        else if (arg == "-s" || arg == "--status")
+        {
+            if (value != NULL && strcmp(value, "flat") == 0)
+                options.status = FLAT_STATUS;
+            else if (value == NULL || strcmp(value, "avl") != 0)
+                return false;
+        }
+        else if (arg == "-e" || arg == "--events")
+        {
+            if (value != NULL && strcmp(value, "heap") == 0)
+                options.events = HEAP_EVENTS;
+            else if (value == NULL || strcmp(value, "avl") != 0)
+                return false;
+        }
+        else if (arg == "-c" || arg == "--coordinates")
+        {
+            if (value != NULL && strcmp(value, "int") == 0)
+                options.coordinates = INTEGER_COORDINATES;
+            else if (value == NULL || strcmp(value, "double") != 0)
+                return false;
+        }
+        else if (arg == "-t" || arg == "--threads")
+        {
+            if (!parseCount(value, MAX_THREADS, options.threads))
+                return false;
+        }
+        else if (arg == "--slabs")
+        {
+            if (!parseCount(value, MAX_SLABS, options.slabs))
+                return false;
+        }
+        else
+        {
+            takesValue = false;
+            if (arg == "--timing")
+                options.timing = true;
+            else if (arg == "--prompt")
+                options.prompt = true;
+            else if (arg == "-h" || arg == "--help")
+                options.help = true;
+            else
+                return false;
+        }
+
+        if (takesValue)
+        {
+            if (value == NULL)
+                return false;
+            i++;
+        }
+    }
+
+    string algorithm = options.algorithm, mode = options.mode;
+    if (algorithm != "sweep" && algorithm != "slab" && algorithm != "brute")
+        return false;
+    if ((mode == "any" || mode == "groups" || options.coordinates == INTEGER_COORDINATES) && algorithm != "sweep")
+        return false;
+    return mode == "text" || mode == "quiet" || mode == "count" || mode == "any" || mode == "groups" || mode == "binary";
+}
+
+/// Print the counters of a sweep to stderr
+void printStats(const SweepStats &stats)
+{
+#ifdef SWEEP_STATS
+    fprintf(stderr,
+            "events %llu\n"
+            "event inserts %llu, merges %llu, deletes %llu, rotations %llu\n"
+            "status inserts %llu, deletes %llu, reorders %llu, rotations %llu, shifts %llu\n"
+            "comparisons %llu, neighbor lookups %llu\n"
+            "findNewEvent calls %llu, new events %llu, duplicates %llu\n"
+            "max event queue size %zu, height %zu\n"
+            "max status size %zu, height %zu\n",
+            stats.events, stats.eventInserts, stats.eventMerges, stats.eventDeletes, stats.eventRotations,
+            stats.statusInserts, stats.statusDeletes, stats.statusReorders, stats.statusRotations, stats.statusShifts,
+            stats.comparisons, stats.neighborLookups,
+            stats.findNewEvents, stats.newEvents, stats.duplicateEvents,
+            stats.maxEventQueueSize, stats.maxEventHeight, stats.maxStatusSize, stats.maxStatusHeight);
+#else
+    (void)stats;
+#endif
+}
+
+/// Build the event queue from a segment source and sweep it
+///
+/// Quiet, count and any runs never store the intersections, and any runs
+/// stop at the first intersection. Groups runs fill groups instead of intersections.
+/// @returns Number of pairs of intersecting segments, or 1 if any run found one
+template<class Source>
+size_t runSweep(Source &source, const Options &options, PhaseTimer &timer, vector<IntersectionRecord> &intersections,
+                IntersectionGroups &groups)
+{
+    string mode = options.mode;
+    FindIntersections findIntersection(source, options.status, options.events, options.threads, options.coordinates);
+    timer.lap("build");
+    size_t pairs;
+    if (mode == "quiet")
+    {
+        NoOpVisitor visitor;
+        findIntersection.runAlgorithm(visitor);
+        pairs = 0;
+    }
+    else if (mode == "count")
+        pairs = findIntersection.countIntersections();
+    else if (mode == "any")
+        pairs = findIntersection.anyIntersection() ? 1 : 0;
+    else if (mode == "groups")
+    {
+        findIntersection.runAlgorithm(groups);
+        pairs = 0;
+    }
+    else
+    {
+        findIntersection.runAlgorithm(intersections);
+        pairs = intersections.size();
+    }
+    if (options.timing)
+        printStats(findIntersection.stats());
+    return pairs;
+}
+
+/// Read the segments with the interactive prompt
+void promptSegments(vector<LineSegment> &segmentVector)
+{
     cout << "Enter the number of lines you want to add : ";
     int n;
     cin >> n;
@@ -17,19 +237,178 @@ int main(){
         l1.endY = y2;
         segmentVector.push_back(l1);
     }
+}
+
+/// Write one line per intersection event: its point, then the IDs of the segments meeting there
+/// @returns false if the output could not be written
+bool writeGroups(const Options &options, const IntersectionGroups &groups)
+{
+    FILE *out = (strcmp(options.output, "-") == 0) ? stdout : fopen(options.output, "w");
+    if (out == NULL)
+        return false;
 
-    
+    bool ok = true;
+    for (size_t k = 0; ok && k < groups.size(); k++)
+    {
+        ok = fprintf(out, "%.17g %.17g", groups.x[k], groups.y[k]) > 0;
+        for (size_t i = groups.offsets[k]; ok && i < groups.offsets[k + 1]; i++)
+            ok = fprintf(out, " %u", groups.ids[i]) > 0;
+        ok = ok && fputc('\n', out) != EOF;
+    }
 
+    if (out == stdout)
+        ok = (fflush(out) == 0) && ok;
+    else
+        ok = (fclose(out) == 0) && ok;
+    return ok;
+}
 
-    // cout << endl << endl;
-    // for(int i=0;i<n;i++)
-    // {
-    //     cout << segmentVector[i].startX << " " << segmentVector[i].startY << " " << segmentVector[i].endX << " " << segmentVector[i].endY << endl;
-    // }
-    
-    cout << endl << "Points of intersections are : \n";
-    FindIntersections findIntersection = FindIntersections(segmentVector);
-    // findIntersection.runAlgorithm();
+/// Write the intersections in the text or binary output mode
+/// @returns false if the output could not be written
+bool writeResults(const Options &options, const vector<IntersectionRecord> &intersections)
+{
+    string mode = options.mode;
+    FILE *out = (strcmp(options.output, "-") == 0) ? stdout : fopen(options.output, "wb");
+    if (out == NULL)
+        return false;
 
-    findIntersection.runAlgorithmB(segmentVector);
-}
\ No newline at end of file
+    bool ok = true;
+    if (mode == "binary")
+    {
+        IntersectionFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, "SWPI", 4);
+        header.version = 1;
+        header.count = intersections.size();
+        ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        for (size_t i = 0; ok && i < intersections.size(); i++)
+        {
+            char record[24];
+            memcpy(record, &intersections[i].x, 8);
+            memcpy(record + 8, &intersections[i].y, 8);
+            memcpy(record + 16, &intersections[i].a, 4);
+            memcpy(record + 20, &intersections[i].b, 4);
+            ok = fwrite(record, sizeof(record), 1, out) == 1;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; ok && i < intersections.size(); i++)
+        {
+            const IntersectionRecord &r = intersections[i];
+            ok = fprintf(out, "%.17g %.17g %u %u\n", r.x, r.y, r.a, r.b) > 0;
+        }
+    }
+
+    if (out == stdout)
+        ok = (fflush(out) == 0) && ok;
+    else
+        ok = (fclose(out) == 0) && ok;
+    return ok;
+}
+
+int main(int argc, char **argv){
+    Options options;
+    if (!parseOptions(argc, argv, options) || options.help)
+    {
+        usage(argv[0]);
+        return options.help ? 0 : 2;
+    }
+    string algorithm = options.algorithm, mode = options.mode;
+    PhaseTimer timer(options.timing);
+
+    // binary files are mapped, text is parsed into segmentVector
+    vector<LineSegment> segmentVector;
+    MappedSegmentFile file;
+    bool mapped = false;
+    if (options.prompt)
+        promptSegments(segmentVector);
+    else if (strcmp(options.input, "-") != 0 && isSegmentFile(options.input))
+    {
+        if (!file.open(options.input))
+        {
+            fprintf(stderr, "%s\n", file.error().c_str());
+            return 1;
+        }
+        mapped = true;
+        // only the sweep reads the mapped file in place
+        if (algorithm != "sweep")
+        {
+            segmentVector.resize(file.size());
+            for (size_t i = 0; i < file.size(); i++)
+                segmentVector[i] = file[i];
+        }
+    }
+    else
+    {
+        string error;
+        if (!parseSegmentTextFile(options.input, segmentVector, options.threads, error))
+        {
+            fprintf(stderr, "%s: %s\n", options.input, error.c_str());
+            return 1;
+        }
+    }
+    timer.lap("parse");
+
+    vector<IntersectionRecord> intersections;
+    IntersectionGroups groups;
+    size_t pairs = 0;
+    if (options.coordinates == INTEGER_COORDINATES &&
+        !(mapped ? onIntegerGrid(file) : onIntegerGrid(segmentVector)))
+    {
+        fprintf(stderr, "%s: coordinates are not integers below 2^31\n", options.input);
+        return 1;
+    }
+    if (algorithm == "sweep")
+    {
+        if (mapped)
+            pairs = runSweep(file, options, timer, intersections, groups);
+        else
+            pairs = runSweep(segmentVector, options, timer, intersections, groups);
+        timer.lap("sweep");
+    }
+    else if (algorithm == "slab")
+    {
+        SlabIntersections slabs(segmentVector, options.slabs, options.threads, options.status, options.events);
+        timer.lap("build");
+        slabs.runAlgorithm(intersections);
+        pairs = intersections.size();
+        if (options.timing)
+            printStats(slabs.stats());
+        timer.lap("sweep");
+    }
+    else
+    {
+        // the brute force only reads its argument, skip building an event queue
+        vector<LineSegment> none;
+        FindIntersections findIntersection(none);
+        findIntersection.runAlgorithmB(segmentVector, intersections, options.threads);
+        pairs = intersections.size();
+        timer.lap("brute");
+    }
+
+    bool ok = true;
+    if (mode == "quiet")
+        ;
+    else if (mode == "count" || mode == "any")
+    {
+        FILE *out = (strcmp(options.output, "-") == 0) ? stdout : fopen(options.output, "w");
+        if (mode == "any")
+            ok = out != NULL && fprintf(out, "%s\n", pairs > 0 ? "yes" : "no") > 0;
+        else
+            ok = out != NULL && fprintf(out, "%zu\n", pairs) > 0;
+        if (out != NULL)
+            ok = ((out == stdout) ? fflush(out) : fclose(out)) == 0 && ok;
+    }
+    else if (mode == "groups")
+        ok = writeGroups(options, groups);
+    else
+        ok = writeResults(options, intersections);
+    if (!ok)
+    {
+        fprintf(stderr, "cannot write %s\n", options.output);
+        return 1;
+    }
+    timer.lap("output");
+    return 0;
+}